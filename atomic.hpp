@@ -0,0 +1,269 @@
+#pragma once
+#include "shared.hpp"
+#include "weak.hpp"
+#include <atomic>      // For std::atomic
+#include <cstdint>     // For std::uintptr_t
+#include <type_traits> // For std::is_same
+#include <utility>     // For std::move
+
+namespace eds {
+
+/****************************************************************************
+*Lock-free slot holding a sharedPointer (or weakPointer) that many threads   *
+*can load while others store into it, built on split reference counts.      *
+*Every stored value lives in a small immutable node. The slot word packs the*
+*node address together with a local count in its top 16 bits:               *
+*  - a reader bumps the local count with one fetch_add, which pins the node,*
+*    copies the handle out of it and then takes its pin back off the word   *
+*  - a writer swaps in a new node and moves the pins of the old word over   *
+*    to the old node's own count, so readers still inside it unpin there    *
+*The slot's reference on a node is worth more than all pins together, so a  *
+*reader that unpins before the writer moved the pins over can never bring   *
+*the count to zero early. The node is freed when its count drops to zero.   *
+*No reader ever waits for a writer or for another reader, and there is no   *
+*mutex anywhere.                                                            *
+*Relies on user space addresses fitting in 48 bits (x86-64, AArch64).       *
+****************************************************************************/
+template <typename Handle> class atomicSlot {
+  static_assert(sizeof(void *) == 8 && sizeof(std::uintptr_t) == 8,
+                "atomicSlot packs a count into the top bits of a 64-bit pointer");
+
+public:
+  atomicSlot(const atomicSlot &) = delete;
+  atomicSlot &operator=(const atomicSlot &) = delete;
+  // Always true, kept for parity with std::atomic
+  static constexpr bool is_always_lock_free = true;
+  bool is_lock_free() const noexcept { return true; }
+
+protected:
+  atomicSlot() noexcept : word_(0) {}
+  explicit atomicSlot(Handle desired) : word_(make_node(std::move(desired))) {}
+  ~atomicSlot() { drop_node(node_of(word_.load(std::memory_order_relaxed)), 0); }
+
+  // Copies the current value out of the slot
+  Handle load_handle() const noexcept;
+  // Puts desired in the slot and returns what was there before
+  Handle exchange_handle(Handle desired);
+  // Replaces the value if it still is expected, otherwise loads it into expected
+  bool compare_exchange_handle(Handle &expected, Handle desired);
+
+private:
+  static constexpr int countShift = 48;
+  static constexpr std::uintptr_t pin = std::uintptr_t(1) << countShift;
+  static constexpr std::uintptr_t addressMask = pin - 1;
+  // More than the 16-bit pin count can ever hold
+  static constexpr std::uintptr_t slotReference = std::uintptr_t(1) << 16;
+
+  // Immutable once published, count covers the slot and the moved-over pins
+  struct node {
+    explicit node(Handle &&value) : handle(std::move(value)) {}
+    const Handle handle;
+    std::atomic<std::uintptr_t> count{slotReference};
+  };
+
+  static node *node_of(std::uintptr_t word) noexcept {
+    return reinterpret_cast<node *>(word & addressMask);
+  }
+  static std::uintptr_t pins_of(std::uintptr_t word) noexcept {
+    return word >> countShift;
+  }
+  // Empty handles are stored as a null node, nothing to allocate for them
+  static std::uintptr_t make_node(Handle &&value);
+  // Gives up the slot's reference on n after moving pins over to its count
+  static void drop_node(node *n, std::uintptr_t pins) noexcept;
+  // Pins the current node and returns the word that was pinned
+  std::uintptr_t acquire_pin() const noexcept;
+  // Takes back a pin taken by acquire_pin
+  void release_pin(std::uintptr_t pinned) const noexcept;
+  // Same handle means the same object and the same ownership
+  static bool same_handle(const Handle &one, const Handle &other) noexcept {
+    return one.pointer_ == other.pointer_ && one.control_ == other.control_;
+  }
+
+  mutable std::atomic<std::uintptr_t> word_;
+};
+
+template <typename Handle>
+std::uintptr_t atomicSlot<Handle>::make_node(Handle &&value) {
+  if (value.control_ == nullptr && value.pointer_ == nullptr) {
+    return 0;
+  }
+  return reinterpret_cast<std::uintptr_t>(new node(std::move(value)));
+}
+
+template <typename Handle>
+void atomicSlot<Handle>::drop_node(node *n, std::uintptr_t pins) noexcept {
+  if (n == nullptr) {
+    return;
+  }
+  // The pins still held by readers now count on the node itself, minus the
+  // reference the slot had on it (unsigned wrap-around does the subtraction).
+  // Zero means no reader is left inside
+  std::uintptr_t change = pins - slotReference;
+  if (n->count.fetch_add(change, std::memory_order_acq_rel) + change == 0) {
+    delete n;
+  }
+}
+
+template <typename Handle>
+std::uintptr_t atomicSlot<Handle>::acquire_pin() const noexcept {
+  return word_.fetch_add(pin, std::memory_order_acquire) + pin;
+}
+
+template <typename Handle>
+void atomicSlot<Handle>::release_pin(std::uintptr_t pinned) const noexcept {
+  std::uintptr_t current = pinned;
+  // While our node is still in the slot the pin is taken off the word
+  while (node_of(current) == node_of(pinned)) {
+    if (word_.compare_exchange_weak(current, current - pin,
+                                    std::memory_order_release,
+                                    std::memory_order_relaxed)) {
+      return;
+    }
+  }
+  // A writer replaced the node and moved our pin over to the node's count
+  node *n = node_of(pinned);
+  if (n != nullptr && n->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete n;
+  }
+}
+
+template <typename Handle>
+Handle atomicSlot<Handle>::load_handle() const noexcept {
+  std::uintptr_t pinned = acquire_pin();
+  node *n = node_of(pinned);
+  Handle result = (n != nullptr) ? n->handle : Handle();
+  release_pin(pinned);
+  return result;
+}
+
+template <typename Handle>
+Handle atomicSlot<Handle>::exchange_handle(Handle desired) {
+  std::uintptr_t fresh = make_node(std::move(desired));
+  std::uintptr_t old = word_.exchange(fresh, std::memory_order_acq_rel);
+  node *n = node_of(old);
+  // The slot's reference keeps the node alive until drop_node below
+  Handle previous = (n != nullptr) ? n->handle : Handle();
+  drop_node(n, pins_of(old));
+  return previous;
+}
+
+template <typename Handle>
+bool atomicSlot<Handle>::compare_exchange_handle(Handle &expected,
+                                                 Handle desired) {
+  std::uintptr_t fresh = 0;
+  bool built = false;
+  for (;;) {
+    std::uintptr_t pinned = acquire_pin();
+    node *n = node_of(pinned);
+    if (n != nullptr ? !same_handle(n->handle, expected)
+                     : (expected.control_ != nullptr || expected.pointer_ != nullptr)) {
+      expected = (n != nullptr) ? n->handle : Handle();
+      release_pin(pinned);
+      if (fresh != 0) {
+        drop_node(node_of(fresh), 0);
+      }
+      return false;
+    }
+    if (!built) {
+      fresh = make_node(std::move(desired));
+      built = true;
+    }
+    // Readers may come and go on the same node, so only the address must match
+    std::uintptr_t current = pinned;
+    while (node_of(current) == n) {
+      // Our own pin is part of current and simply disappears with the swap
+      if (word_.compare_exchange_weak(current, fresh, std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+        drop_node(n, pins_of(current) - 1);
+        return true;
+      }
+    }
+    // Another writer got in between, look at the new value
+    release_pin(pinned);
+  }
+}
+
+// Atomic slot for a sharedPointer, Policy has to be a thread-safe one
+template <typename T, typename Policy = atomicCount>
+class atomicSharedPointer : public atomicSlot<sharedPointer<T, Policy>> {
+  static_assert(!std::is_same<Policy, nonAtomicCount>::value,
+                "atomicSharedPointer needs thread-safe reference counting");
+  using base = atomicSlot<sharedPointer<T, Policy>>;
+
+public:
+  // Default constructor, the slot starts out empty
+  atomicSharedPointer() noexcept = default;
+  // Constructor storing an initial value
+  atomicSharedPointer(sharedPointer<T, Policy> desired)
+      : base(std::move(desired)) {}
+  // Snapshot of the current value, never blocks
+  sharedPointer<T, Policy> load() const noexcept { return this->load_handle(); }
+  // Replaces the current value
+  void store(sharedPointer<T, Policy> desired) {
+    this->exchange_handle(std::move(desired));
+  }
+  // Replaces the current value and returns the previous one
+  sharedPointer<T, Policy> exchange(sharedPointer<T, Policy> desired) {
+    return this->exchange_handle(std::move(desired));
+  }
+  // Stores desired only if the slot still holds expected (same object and
+  // same owner), otherwise copies the current value into expected
+  bool compare_exchange_strong(sharedPointer<T, Policy> &expected,
+                               sharedPointer<T, Policy> desired) {
+    return this->compare_exchange_handle(expected, std::move(desired));
+  }
+  // Never fails spuriously, same as compare_exchange_strong
+  bool compare_exchange_weak(sharedPointer<T, Policy> &expected,
+                             sharedPointer<T, Policy> desired) {
+    return this->compare_exchange_handle(expected, std::move(desired));
+  }
+  // Conversion and assignment, same as load and store
+  operator sharedPointer<T, Policy>() const noexcept { return load(); }
+  atomicSharedPointer &operator=(sharedPointer<T, Policy> desired) {
+    store(std::move(desired));
+    return *this;
+  }
+};
+
+// Atomic slot for a weakPointer, for caches that must not keep objects alive
+template <typename T, typename Policy = atomicCount>
+class atomicWeakPointer : public atomicSlot<weakPointer<T, Policy>> {
+  static_assert(!std::is_same<Policy, nonAtomicCount>::value,
+                "atomicWeakPointer needs thread-safe reference counting");
+  using base = atomicSlot<weakPointer<T, Policy>>;
+
+public:
+  // Default constructor, the slot starts out empty
+  atomicWeakPointer() noexcept = default;
+  // Constructor storing an initial value
+  atomicWeakPointer(weakPointer<T, Policy> desired) : base(std::move(desired)) {}
+  // Snapshot of the current value, never blocks
+  weakPointer<T, Policy> load() const noexcept { return this->load_handle(); }
+  // Replaces the current value
+  void store(weakPointer<T, Policy> desired) {
+    this->exchange_handle(std::move(desired));
+  }
+  // Replaces the current value and returns the previous one
+  weakPointer<T, Policy> exchange(weakPointer<T, Policy> desired) {
+    return this->exchange_handle(std::move(desired));
+  }
+  // Stores desired only if the slot still holds expected
+  bool compare_exchange_strong(weakPointer<T, Policy> &expected,
+                               weakPointer<T, Policy> desired) {
+    return this->compare_exchange_handle(expected, std::move(desired));
+  }
+  // Never fails spuriously, same as compare_exchange_strong
+  bool compare_exchange_weak(weakPointer<T, Policy> &expected,
+                             weakPointer<T, Policy> desired) {
+    return this->compare_exchange_handle(expected, std::move(desired));
+  }
+  // Conversion and assignment, same as load and store
+  operator weakPointer<T, Policy>() const noexcept { return load(); }
+  atomicWeakPointer &operator=(weakPointer<T, Policy> desired) {
+    store(std::move(desired));
+    return *this;
+  }
+};
+
+} // namespace eds
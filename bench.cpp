@@ -0,0 +1,445 @@
+/********************************************************
+ *                                                      *
+ *      Benchmarks for the custom smart pointer         *
+ *      implementation, side by side with std::         *
+ *                                                      *
+ ********************************************************/
+
+// Usage: ./bench [--csv] [--iterations N]
+// --csv prints one line per measurement instead of the readable report:
+//   section,case,impl,ns_per_op,allocs_per_op,bytes_per_op
+// so the results of two revisions can simply be diffed.
+
+#include "biased.hpp"
+#include "pool.hpp"
+#include "shared.hpp"
+#include "unique.hpp"
+#include "weak.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Allocations made by the calling thread, counted by the operator new below
+static thread_local long allocationCount = 0;
+static thread_local long allocationBytes = 0;
+
+void *operator new(std::size_t size) {
+  ++allocationCount;
+  allocationBytes += size;
+  if (void *ptr = std::malloc(size != 0 ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void *operator new(std::size_t size, std::align_val_t align) {
+  ++allocationCount;
+  allocationBytes += size;
+  std::size_t alignment = static_cast<std::size_t>(align);
+  // aligned_alloc wants a multiple of the alignment
+  if (void *ptr = std::aligned_alloc(
+          alignment, (size + alignment - 1) / alignment * alignment)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+
+// Keeps the compiler from dropping the measured copies
+template <typename T> void keep(T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Cost of one iteration
+struct sample {
+  double ns;
+  double allocs;
+  double bytes;
+};
+
+// Runs body iterations times and returns the average cost per iteration
+template <typename Body> sample measure(long iterations, Body body) {
+  // Divided counts like iterations / 4 still run the body once
+  iterations = std::max(iterations, 1L);
+  long allocs = allocationCount;
+  long bytes = allocationBytes;
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; ++i) {
+    body();
+  }
+  auto stop = std::chrono::steady_clock::now();
+  return {std::chrono::duration<double, std::nano>(stop - start).count() /
+              iterations,
+          double(allocationCount - allocs) / iterations,
+          double(allocationBytes - bytes) / iterations};
+}
+
+// Fills a batch of handles with make (not timed) and then times drop on each
+// of them, for operations that need a fresh handle every time (destroy)
+template <typename Handle, typename Make, typename Drop>
+sample measure_batched(long iterations, Make make, Drop drop) {
+  const long batch = 1024;
+  std::vector<Handle> handles(batch);
+  sample total{0, 0, 0};
+  // At least one round, even for --iterations below one batch
+  long rounds = std::max(iterations / batch, 1L);
+  for (long round = 0; round < rounds; ++round) {
+    for (auto &handle : handles) {
+      handle = make();
+    }
+    auto it = handles.begin();
+    sample part = measure(batch, [&it, &drop] { drop(*it++); });
+    total.ns += part.ns;
+    total.allocs += part.allocs;
+    total.bytes += part.bytes;
+  }
+  return {total.ns / rounds, total.allocs / rounds, total.bytes / rounds};
+}
+
+// Prints the results either as a readable report or as CSV
+class reporter {
+public:
+  explicit reporter(bool csv) : csv_(csv) {
+    if (csv_) {
+      std::cout << "section,case,impl,ns_per_op,allocs_per_op,bytes_per_op"
+                << std::endl;
+    }
+  }
+  // Starts a new group of cases
+  void section(const std::string &title) {
+    section_ = title;
+    first_ = true;
+    if (csv_) {
+      return;
+    }
+    std::cout << "*********************************************************"
+              << std::endl;
+    std::cout << std::endl << "\t\t" << title << std::endl;
+    std::cout << std::endl
+              << "*********************************************************"
+              << std::endl;
+  }
+  // Starts a new case inside the section
+  void item(const std::string &name) {
+    case_ = name;
+    if (csv_) {
+      return;
+    }
+    if (!first_) {
+      std::cout << "--------------------------------------------------------------------------------------------------------------"
+                << std::endl;
+    }
+    first_ = false;
+    std::cout << name << std::endl;
+  }
+  // One measurement of the current case
+  void row(const std::string &impl, sample result) {
+    if (csv_) {
+      std::cout << quoted(section_) << ',' << quoted(case_) << ','
+                << quoted(impl) << ',' << result.ns
+                << ',' << result.allocs << ',' << result.bytes << std::endl;
+      return;
+    }
+    std::cout << "  " << impl << ":" << std::string(17 - impl.size(), ' ')
+              << result.ns << " ns/op, " << result.allocs << " allocs/op, "
+              << result.bytes << " B/op" << std::endl;
+  }
+
+private:
+  // CSV field, quoted if it contains a separator or a quote
+  static std::string quoted(const std::string &text) {
+    if (text.find_first_of(",\"") == std::string::npos) {
+      return text;
+    }
+    std::string field = "\"";
+    for (char c : text) {
+      field += c;
+      if (c == '"') {
+        field += '"';
+      }
+    }
+    return field + '"';
+  }
+
+  bool csv_;
+  bool first_ = true;
+  std::string section_;
+  std::string case_;
+};
+
+/****************************************************************************
+*eds:: against std:: for the single-threaded basics. Every case is written  *
+*once as a template over a small traits struct, so both sides run exactly   *
+*the same code around the operation being measured.                         *
+****************************************************************************/
+struct edsPointers {
+  static constexpr const char *name = "eds";
+  template <typename T> using shared = eds::sharedPointer<T>;
+  template <typename T> using weak = eds::weakPointer<T>;
+  template <typename T> using unique = eds::uniquePointer<T>;
+  template <typename T> static shared<T> make_shared(T value) {
+    return eds::make_shared<T>(value);
+  }
+  template <typename T> static unique<T> make_unique(T value) {
+    return eds::make_unique<T>(value);
+  }
+};
+
+struct stdPointers {
+  static constexpr const char *name = "std";
+  template <typename T> using shared = std::shared_ptr<T>;
+  template <typename T> using weak = std::weak_ptr<T>;
+  template <typename T> using unique = std::unique_ptr<T>;
+  template <typename T> static shared<T> make_shared(T value) {
+    return std::make_shared<T>(value);
+  }
+  template <typename T> static unique<T> make_unique(T value) {
+    return std::make_unique<T>(value);
+  }
+};
+
+template <typename P>
+void shared_cases(reporter &report, long iterations, const std::string &item) {
+  using shared = typename P::template shared<int>;
+  using weak = typename P::template weak<int>;
+  if (item == "construct") {
+    report.row(P::name, measure(iterations, [] {
+                 shared adopted(new int(1));
+                 keep(adopted);
+               }));
+  } else if (item == "make_shared") {
+    report.row(P::name, measure(iterations, [] {
+                 shared fresh = P::make_shared(1);
+                 keep(fresh);
+               }));
+  } else if (item == "copy") {
+    shared source = P::make_shared(1);
+    report.row(P::name, measure(iterations, [&source] {
+                 shared copy(source);
+                 keep(copy);
+               }));
+  } else if (item == "move") {
+    shared one = P::make_shared(1);
+    shared other;
+    report.row(P::name, measure(iterations, [&one, &other] {
+                 other = std::move(one);
+                 one = std::move(other);
+                 keep(one);
+               }));
+  } else if (item == "destroy") {
+    report.row(P::name, measure_batched<shared>(
+                            iterations, [] { return P::make_shared(1); },
+                            [](shared &handle) { handle = shared(); }));
+  } else if (item == "lock") {
+    shared owner = P::make_shared(1);
+    weak observer = owner;
+    report.row(P::name, measure(iterations, [&observer] {
+                 shared locked = observer.lock();
+                 keep(locked);
+               }));
+  } else if (item == "reset") {
+    shared owner = P::make_shared(1);
+    report.row(P::name, measure(iterations, [&owner] {
+                 owner.reset(new int(1));
+                 keep(owner);
+               }));
+  } else if (item == "swap") {
+    shared one = P::make_shared(1);
+    shared other = P::make_shared(2);
+    report.row(P::name, measure(iterations, [&one, &other] {
+                 one.swap(other);
+                 keep(one);
+               }));
+  }
+}
+
+template <typename P>
+void unique_cases(reporter &report, long iterations, const std::string &item) {
+  using unique = typename P::template unique<int>;
+  if (item == "construct") {
+    report.row(P::name, measure(iterations, [] {
+                 unique adopted(new int(1));
+                 keep(adopted);
+               }));
+  } else if (item == "make_unique") {
+    report.row(P::name, measure(iterations, [] {
+                 unique fresh = P::make_unique(1);
+                 keep(fresh);
+               }));
+  } else if (item == "move") {
+    unique one = P::make_unique(1);
+    unique other;
+    report.row(P::name, measure(iterations, [&one, &other] {
+                 other = std::move(one);
+                 one = std::move(other);
+                 keep(one);
+               }));
+  } else if (item == "destroy") {
+    report.row(P::name, measure_batched<unique>(
+                            iterations, [] { return P::make_unique(1); },
+                            [](unique &handle) { handle.reset(); }));
+  } else if (item == "reset") {
+    unique owner = P::make_unique(1);
+    report.row(P::name, measure(iterations, [&owner] {
+                 owner.reset(new int(1));
+                 keep(owner);
+               }));
+  } else if (item == "swap") {
+    unique one = P::make_unique(1);
+    unique other = P::make_unique(2);
+    report.row(P::name, measure(iterations, [&one, &other] {
+                 one.swap(other);
+                 keep(one);
+               }));
+  }
+}
+
+// One copy and one destroy of a handle on the thread that created the object
+template <typename Policy> sample owner_copy(long iterations) {
+  eds::sharedPointer<int, Policy> source = eds::make_shared<int, Policy>(1);
+  return measure(iterations, [&source] {
+    eds::sharedPointer<int, Policy> copy(source);
+    keep(copy);
+  });
+}
+
+// Same, but threads other than the creator do the copying
+template <typename Policy> sample remote_copy(long iterations, int threads) {
+  eds::sharedPointer<int, Policy> source = eds::make_shared<int, Policy>(1);
+  std::vector<std::thread> workers;
+  std::vector<sample> results(threads);
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&source, &results, t, iterations] {
+      results[t] = measure(iterations, [&source] {
+        eds::sharedPointer<int, Policy> copy(source);
+        keep(copy);
+      });
+    });
+  }
+  sample total{0, 0, 0};
+  for (int t = 0; t < threads; ++t) {
+    workers[t].join();
+    total.ns += results[t].ns;
+    total.allocs += results[t].allocs;
+    total.bytes += results[t].bytes;
+  }
+  return {total.ns / threads, total.allocs / threads, total.bytes / threads};
+}
+
+// make_shared of a small object through Alloc, created and destroyed in place
+template <typename Alloc> sample fused_block(long iterations) {
+  return measure(iterations, [] {
+    eds::sharedPointer<int> fresh = eds::allocate_shared<int>(Alloc(), 1);
+    keep(fresh);
+  });
+}
+
+// sharedPointer(T*) with its separate control block allocated through Alloc
+template <typename Alloc> sample separate_block(long iterations) {
+  return measure(iterations, [] {
+    eds::sharedPointer<int> adopted(new int(1), eds::defaultDelete<int>(), Alloc());
+    keep(adopted);
+  });
+}
+
+// Blocks created on one thread and released on another, cost per block for
+// the pair. Each round the producer fills a batch the consumer then drops
+template <typename Alloc> sample cross_thread_block(long iterations) {
+  const long batch = 1024;
+  std::vector<eds::sharedPointer<int, eds::atomicCount>> handles(batch);
+  std::atomic<int> turn{0};
+  // At least one round, even for --iterations below one batch
+  long rounds = std::max(iterations / batch, 1L);
+  std::thread consumer([&] {
+    for (long round = 0; round < rounds; ++round) {
+      while (turn.load(std::memory_order_acquire) != 1) {
+        std::this_thread::yield();
+      }
+      for (auto &handle : handles) {
+        handle.reset();
+      }
+      turn.store(0, std::memory_order_release);
+    }
+  });
+  sample result = measure(rounds, [&] {
+    while (turn.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+    for (auto &handle : handles) {
+      handle = eds::allocate_shared<int, eds::atomicCount>(Alloc(), 1);
+    }
+    turn.store(1, std::memory_order_release);
+  });
+  consumer.join();
+  return {result.ns / batch, result.allocs / batch, result.bytes / batch};
+}
+
+int main(int argc, char **argv) {
+  bool csv = false;
+  long iterations = 5000000;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = std::atol(argv[++i]);
+      if (iterations < 1) {
+        std::cerr << "--iterations needs a positive count" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--csv] [--iterations N]"
+                << std::endl;
+      return 1;
+    }
+  }
+  reporter report(csv);
+
+  report.section("sharedPointer against std::shared_ptr");
+  for (const char *item : {"construct", "make_shared", "copy", "move",
+                           "destroy", "lock", "reset", "swap"}) {
+    report.item(item);
+    shared_cases<edsPointers>(report, iterations, item);
+    shared_cases<stdPointers>(report, iterations, item);
+  }
+
+  report.section("uniquePointer against std::unique_ptr");
+  for (const char *item :
+       {"construct", "make_unique", "move", "destroy", "reset", "swap"}) {
+    report.item(item);
+    unique_cases<edsPointers>(report, iterations, item);
+    unique_cases<stdPointers>(report, iterations, item);
+  }
+
+  report.section("Biased counting benchmark");
+  report.item("Copy + destroy on the owner thread");
+  report.row("nonAtomicCount", owner_copy<eds::nonAtomicCount>(iterations));
+  report.row("atomicCount", owner_copy<eds::atomicCount>(iterations));
+  report.row("biasedCount", owner_copy<eds::biasedCount>(iterations));
+  report.item("Copy + destroy on 2 threads that do not own the object");
+  report.row("atomicCount", remote_copy<eds::atomicCount>(iterations / 4, 2));
+  report.row("biasedCount", remote_copy<eds::biasedCount>(iterations / 4, 2));
+
+  report.section("Control block allocation benchmark");
+  report.item("make_shared<int> create + destroy");
+  report.row("std::allocator", fused_block<std::allocator<int>>(iterations));
+  report.row("pooledAllocator", fused_block<eds::pooledAllocator<int>>(iterations));
+  report.item("sharedPointer(new int) create + destroy");
+  report.row("std::allocator", separate_block<std::allocator<int>>(iterations));
+  report.row("pooledAllocator",
+             separate_block<eds::pooledAllocator<int>>(iterations));
+  report.item("make_shared<int> on one thread and released on another");
+  report.row("std::allocator",
+             cross_thread_block<std::allocator<int>>(iterations / 4));
+  report.row("pooledAllocator",
+             cross_thread_block<eds::pooledAllocator<int>>(iterations / 4));
+  return 0;
+}
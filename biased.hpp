@@ -0,0 +1,378 @@
+#pragma once
+#include "policy.hpp"
+#include <atomic>  // For std::atomic
+#include <cstddef> // For std::size_t
+#include <cstdint> // For std::int64_t, std::uint64_t
+#include <mutex>   // For std::mutex, std::lock_guard
+#include <utility> // For std::swap
+#include <vector>  // For the merge queues
+
+namespace eds {
+
+/****************************************************************************
+*Biased reference counting: the thread that creates an object owns its      *
+*counts. On that thread a copy or a destroy is a plain ++/-- on the biased  *
+*count, every other thread goes through an atomic shared count. When the    *
+*owner drops its last reference the two counts are merged and from then on  *
+*only the atomic count is used.                                             *
+*If another thread drops references the owner made (for example a handle    *
+*moved to a worker), the shared count goes negative. That thread then queues*
+*the object on its owner, and the owner merges it the next time it creates  *
+*a biased object, drops its own last reference, calls biased_merge_pending()*
+*or exits. Until that merge the object stays alive, so lock() may still     *
+*succeed on it.                                                             *
+****************************************************************************/
+
+class biasedCountsBase;
+
+// Per-thread record holding the queue of objects waiting for their owner
+class biasedThread {
+public:
+  // Id of the calling thread, 0 if it never created a biased object
+  static std::uint64_t current_id() noexcept { return threadId_; }
+  // Record of the calling thread, registers the thread on first use
+  static biasedThread *current();
+  // Merges every object queued on the calling thread
+  static void drain() noexcept;
+  // Hands an object to its owner, or merges it right away if the owner exited
+  void enqueue(biasedCountsBase *counts) noexcept;
+  // True if other threads queued objects since the last drain
+  bool pending() const noexcept {
+    return pending_.load(std::memory_order_relaxed);
+  }
+
+private:
+  // Unregisters the thread when it exits, see current()
+  struct exitGuard {
+    ~exitGuard();
+  };
+
+  static void merge_all(std::vector<biasedCountsBase *> &queued) noexcept;
+  // Records of exited threads, reused by new threads so they never pile up
+  static std::vector<biasedThread *> &free_records();
+  static std::mutex &registry_mutex();
+
+  std::mutex mutex_;
+  std::vector<biasedCountsBase *> queue_;
+  std::atomic<bool> pending_{false};
+  bool alive_ = true;
+
+  static inline std::atomic<std::uint64_t> nextId_{1};
+  static inline thread_local std::uint64_t threadId_ = 0;
+  static inline thread_local biasedThread *record_ = nullptr;
+};
+
+// Counter state and the thread-independent part of the biased logic
+class biasedCountsBase {
+public:
+  biasedCountsBase(const biasedCountsBase &) = delete;
+  biasedCountsBase &operator=(const biasedCountsBase &) = delete;
+
+  // Merges a queued object, only ever called on behalf of its owner
+  virtual void merge_queued() noexcept = 0;
+
+protected:
+  // Owner id once merged, no thread has it
+  static constexpr std::uint64_t noOwner = ~std::uint64_t(0);
+  // Low bits of shared_ are flags, the (signed) count sits above them
+  static constexpr std::int64_t merged = 1;
+  static constexpr std::int64_t queued = 2;
+  static constexpr std::int64_t one = 4;
+
+  biasedCountsBase();
+  ~biasedCountsBase() = default;
+
+  static std::int64_t count_of(std::int64_t value) noexcept {
+    return (value - (value & (one - 1))) / one;
+  }
+  bool owned_here() const noexcept {
+    return owner_.load(std::memory_order_relaxed) == biasedThread::current_id();
+  }
+  // Owner dropped its last biased reference, true if the object is dead
+  bool merge_by_owner() noexcept;
+  // Folds the biased count into the shared one, true if the object is dead
+  bool merge_biased() noexcept;
+  // Atomic decrement from a thread that is not the owner. Sets queue if the
+  // object has to be handed to its owner, and extraWeak if a weak reference
+  // was taken for a queue entry that did not happen after all
+  bool decrement_shared_remote(bool &queue, bool &extraWeak) noexcept;
+
+  // Weak count while is_unique runs
+  static constexpr std::size_t weakLocked = ~std::size_t(0);
+
+  // Adds a weak reference, waiting while is_unique has the count locked
+  void add_weak_reference() noexcept {
+    std::size_t count = weak_.load(std::memory_order_relaxed);
+    for (;;) {
+      if (count == weakLocked) {
+        count = weak_.load(std::memory_order_relaxed);
+      } else if (weak_.compare_exchange_weak(count, count + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  biasedThread *const record_;
+  std::atomic<std::uint64_t> owner_;
+  std::size_t biased_ = 1;
+  std::atomic<std::int64_t> shared_{0};
+  // Holds one extra reference on behalf of all strong owners
+  std::atomic<std::size_t> weak_{1};
+};
+
+struct biasedCount {
+  template <typename Block> class counts : public biasedCountsBase {
+  public:
+    void increment_shared() noexcept {
+      if (owned_here()) {
+        ++biased_;
+      } else {
+        shared_.fetch_add(one, std::memory_order_relaxed);
+      }
+    }
+    bool increment_shared_if_nonzero() noexcept;
+    bool decrement_shared() noexcept;
+    void increment_weak() noexcept { add_weak_reference(); }
+    bool decrement_weak() noexcept {
+      return weak_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    // Exact on the owner thread and once merged, otherwise an estimate
+    std::size_t shared_count() const noexcept;
+    std::size_t weak_count() const noexcept {
+      std::size_t count = weak_.load(std::memory_order_relaxed);
+      return count == weakLocked ? 1 : count;
+    }
+    // Only ever true on the owner thread, elsewhere the biased part is unknown.
+    // The weak count is locked while the shared one is read, as for atomicCount
+    bool is_unique() noexcept {
+      if (!owned_here() || biased_ != 1) {
+        return false;
+      }
+      std::size_t expected = 1;
+      if (!weak_.compare_exchange_strong(expected, weakLocked,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+        return false;
+      }
+      bool unique = count_of(shared_.load(std::memory_order_acquire)) == 0;
+      weak_.store(1, std::memory_order_release);
+      return unique;
+    }
+    void merge_queued() noexcept override;
+
+  private:
+    Block *block() noexcept { return static_cast<Block *>(this); }
+  };
+};
+
+inline biasedThread *biasedThread::current() {
+  if (record_ == nullptr) {
+    biasedThread *record = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(registry_mutex());
+      if (!free_records().empty()) {
+        record = free_records().back();
+        free_records().pop_back();
+      }
+    }
+    if (record == nullptr) {
+      record = new biasedThread();
+    } else {
+      std::lock_guard<std::mutex> lock(record->mutex_);
+      record->alive_ = true;
+    }
+    // Constructed on first use, its destructor runs when the thread exits
+    static thread_local exitGuard guard;
+    (void)guard;
+    record_ = record;
+    threadId_ = nextId_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return record_;
+}
+
+inline void biasedThread::drain() noexcept {
+  biasedThread *record = record_;
+  if (record == nullptr || !record->pending()) {
+    return;
+  }
+  std::vector<biasedCountsBase *> queued;
+  {
+    std::lock_guard<std::mutex> lock(record->mutex_);
+    queued.swap(record->queue_);
+    record->pending_.store(false, std::memory_order_relaxed);
+  }
+  merge_all(queued);
+}
+
+inline void biasedThread::enqueue(biasedCountsBase *counts) noexcept {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (alive_) {
+      queue_.push_back(counts);
+      pending_.store(true, std::memory_order_relaxed);
+      return;
+    }
+  }
+  // The owner is gone and will never touch the biased count again, the mutex
+  // above orders its last write before our merge
+  counts->merge_queued();
+}
+
+inline void biasedThread::merge_all(
+    std::vector<biasedCountsBase *> &queued) noexcept {
+  for (biasedCountsBase *counts : queued) {
+    counts->merge_queued();
+  }
+}
+
+inline std::vector<biasedThread *> &biasedThread::free_records() {
+  // Never destroyed, threads may still exit while statics are torn down
+  static std::vector<biasedThread *> *records = new std::vector<biasedThread *>();
+  return *records;
+}
+
+inline std::mutex &biasedThread::registry_mutex() {
+  static std::mutex *mutex = new std::mutex();
+  return *mutex;
+}
+
+inline biasedThread::exitGuard::~exitGuard() {
+  biasedThread *record = record_;
+  std::vector<biasedCountsBase *> queued;
+  {
+    std::lock_guard<std::mutex> lock(record->mutex_);
+    record->alive_ = false;
+    queued.swap(record->queue_);
+    record->pending_.store(false, std::memory_order_relaxed);
+  }
+  // From here on this thread owns nothing, destructors run by the merges
+  // below take the shared path like on any other thread
+  threadId_ = 0;
+  record_ = nullptr;
+  merge_all(queued);
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  free_records().push_back(record);
+}
+
+inline biasedCountsBase::biasedCountsBase()
+    : record_(biasedThread::current()), owner_(biasedThread::current_id()) {
+  // Creating objects is already a slow path, a good time to catch up
+  biasedThread::drain();
+}
+
+inline bool biasedCountsBase::merge_by_owner() noexcept {
+  owner_.store(noOwner, std::memory_order_relaxed);
+  // The merged bit is clear, so adding it just sets it
+  std::int64_t old = shared_.fetch_add(merged, std::memory_order_acq_rel);
+  return count_of(old) == 0;
+}
+
+inline bool biasedCountsBase::merge_biased() noexcept {
+  if (shared_.load(std::memory_order_relaxed) & merged) {
+    // The owner merged on its own after this object was queued
+    return false;
+  }
+  owner_.store(noOwner, std::memory_order_relaxed);
+  std::int64_t biased = static_cast<std::int64_t>(biased_);
+  biased_ = 0;
+  std::int64_t old =
+      shared_.fetch_add(biased * one + merged, std::memory_order_acq_rel);
+  return count_of(old) + biased == 0;
+}
+
+inline bool biasedCountsBase::decrement_shared_remote(bool &queue,
+                                                      bool &extraWeak) noexcept {
+  std::int64_t value = shared_.load(std::memory_order_relaxed);
+  extraWeak = false;
+  for (;;) {
+    std::int64_t next = value - one;
+    queue = !(value & (merged | queued)) && count_of(next) < 0;
+    if (queue) {
+      next |= queued;
+      if (!extraWeak) {
+        // The queue keeps the block alive until the owner looked at it. We
+        // still hold our strong reference here, so the block cannot go away
+        add_weak_reference();
+        extraWeak = true;
+      }
+    }
+    if (shared_.compare_exchange_weak(value, next, std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+      if (queue) {
+        extraWeak = false;
+      }
+      return !queue && (value & merged) && count_of(next) == 0;
+    }
+  }
+}
+
+template <typename Block>
+bool biasedCount::counts<Block>::increment_shared_if_nonzero() noexcept {
+  if (owned_here()) {
+    // While unmerged the owner still holds at least one biased reference
+    ++biased_;
+    return true;
+  }
+  std::int64_t value = shared_.load(std::memory_order_relaxed);
+  while (!((value & merged) && count_of(value) == 0)) {
+    if (shared_.compare_exchange_weak(value, value + one,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Block>
+bool biasedCount::counts<Block>::decrement_shared() noexcept {
+  if (owned_here()) {
+    if (--biased_ != 0) {
+      return false;
+    }
+    bool dead = merge_by_owner();
+    biasedThread::drain();
+    return dead;
+  }
+  bool queue = false;
+  bool extraWeak = false;
+  bool dead = decrement_shared_remote(queue, extraWeak);
+  if (queue) {
+    record_->enqueue(this);
+  } else if (extraWeak) {
+    // Raced with a merge, nothing to queue after all. If dead the strong
+    // owners' weak reference is still there, so this is never the last one
+    block()->release_weak();
+  }
+  return dead;
+}
+
+template <typename Block>
+std::size_t biasedCount::counts<Block>::shared_count() const noexcept {
+  std::int64_t value = shared_.load(std::memory_order_relaxed);
+  std::int64_t count = count_of(value);
+  if (owned_here()) {
+    count += static_cast<std::int64_t>(biased_);
+  } else if (!(value & merged)) {
+    // The biased part is unknown here, but the owner still holds one
+    count = (count < 0 ? 0 : count) + 1;
+  }
+  return count < 0 ? 0 : static_cast<std::size_t>(count);
+}
+
+template <typename Block>
+void biasedCount::counts<Block>::merge_queued() noexcept {
+  if (merge_biased()) {
+    block()->expire();
+  }
+  // Drops the reference the queue was holding
+  block()->release_weak();
+}
+
+// Merges the objects other threads queued on the calling thread, for owners
+// that keep long-lived handles and rarely create new biased objects
+inline void biased_merge_pending() noexcept { biasedThread::drain(); }
+
+} // namespace eds
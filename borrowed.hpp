@@ -0,0 +1,106 @@
+#pragma once
+#include "shared.hpp"
+#include "unique.hpp"
+#include <cstddef>     // For std::nullptr_t
+#include <type_traits> // For std::enable_if_t, std::is_convertible
+
+namespace eds {
+
+/****************************************************************************
+*Views for passing owned objects to functions that only use them for the    *
+*duration of the call. Taking a sharedPointer by value costs an increment   *
+*and a decrement per call (two lock-prefixed instructions with atomicCount),*
+*binding a view costs nothing:                                              *
+*  borrowed<T>          one pointer, made from a sharedPointer of any       *
+*                       Policy, a uniquePointer or a plain reference        *
+*  sharedRef<T, Policy> pointer and control block of a sharedPointer, for   *
+*                       callees that sometimes keep the object: share()     *
+*                       turns it back into an owning sharedPointer          *
+*Both convert implicitly, so a parameter type change is all it takes. Like  *
+*a reference, a view must not outlive the owner it was made from.           *
+****************************************************************************/
+
+// Non-owning view of a T, one pointer wide
+template <typename T> class borrowed {
+  template <typename U>
+  using compatible = std::enable_if_t<std::is_convertible<U *, T *>::value>;
+
+public:
+  // Empty view
+  borrowed(std::nullptr_t) noexcept : pointer_(nullptr) {}
+  // View of a plain object
+  borrowed(T &object) noexcept : pointer_(&object) {}
+  // View of the object of a sharedPointer
+  template <typename U, typename Policy, typename = compatible<U>>
+  borrowed(const sharedPointer<U, Policy> &owner) noexcept
+      : pointer_(owner.get()) {}
+  // View of the object of a uniquePointer
+  template <typename U, typename D, typename = compatible<U>>
+  borrowed(const uniquePointer<U, D> &owner) noexcept : pointer_(owner.get()) {}
+  // Function to get the raw pointer
+  T *get() const noexcept { return pointer_; }
+  // Dereference operator
+  T &operator*() const noexcept { return *pointer_; }
+  // Member access operator
+  T *operator->() const noexcept { return pointer_; }
+  // Explicit conversion operator to bool
+  explicit operator bool() const noexcept { return pointer_ != nullptr; }
+
+private:
+  T *pointer_;
+};
+
+// Non-owning view of a sharedPointer that can be turned back into an owner
+template <typename T, typename Policy = nonAtomicCount> class sharedRef {
+  template <typename U>
+  using compatible = std::enable_if_t<std::is_convertible<U *, T *>::value>;
+
+public:
+  // Empty view
+  sharedRef(std::nullptr_t) noexcept : pointer_(nullptr), control_(nullptr) {}
+  // View of owner, no count is touched
+  template <typename U, typename = compatible<U>>
+  sharedRef(const sharedPointer<U, Policy> &owner) noexcept
+      : pointer_(owner.pointer_), control_(owner.control_) {}
+  // New owner of the viewed object, one increment
+  sharedPointer<T, Policy> share() const noexcept;
+  // Strong owners of the object
+  std::size_t use_count() const noexcept;
+  // Function to get the raw pointer
+  T *get() const noexcept { return pointer_; }
+  // Dereference operator
+  T &operator*() const noexcept { return *pointer_; }
+  // Member access operator
+  T *operator->() const noexcept { return pointer_; }
+  // Explicit conversion operator to bool
+  explicit operator bool() const noexcept { return pointer_ != nullptr; }
+  // A sharedRef is also a borrowed view
+  operator borrowed<T>() const noexcept {
+    return pointer_ != nullptr ? borrowed<T>(*pointer_) : borrowed<T>(nullptr);
+  }
+
+private:
+  T *pointer_;
+  controlBlock<Policy> *control_;
+};
+
+// New owner of the viewed object
+template <typename T, typename Policy>
+sharedPointer<T, Policy> sharedRef<T, Policy>::share() const noexcept {
+  sharedPointer<T, Policy> result;
+  if (control_ != nullptr) {
+    control_->add_shared();
+    result.pointer_ = pointer_;
+    result.control_ = control_;
+    EDS_COUNT(T, copy);
+  }
+  return result;
+}
+
+// Strong owners of the object
+template <typename T, typename Policy>
+std::size_t sharedRef<T, Policy>::use_count() const noexcept {
+  return control_ != nullptr ? control_->shared_count() : 0;
+}
+
+} // namespace eds
@@ -0,0 +1,230 @@
+#pragma once
+#include "shared.hpp"
+#include "weak.hpp"
+#include <condition_variable> // For std::condition_variable
+#include <cstddef>            // For std::size_t
+#include <cstdint>            // For std::uint64_t
+#include <functional>         // For std::hash
+#include <mutex>              // For std::mutex, std::lock_guard, std::unique_lock
+#include <type_traits>        // For std::is_same
+#include <unordered_map>      // For the shard maps
+#include <utility>            // For std::move
+#include <vector>             // For the keys swept by a purge step
+
+namespace eds {
+
+/****************************************************************************
+*weakValueCache: an interning cache whose values disappear once nobody uses *
+*them. Entries hold weakPointers, so the cache itself never keeps a value   *
+*alive, and a hit is a lock() on the weakPointer.                           *
+*  - keys are spread over Shards independently locked maps, threads working *
+*    on different keys rarely meet on a mutex                               *
+*  - a miss inserts a placeholder and builds the value outside the lock.    *
+*    Other threads missing on the same key wait for that one build instead  *
+*    of running the factory themselves. If the factory throws, one of the   *
+*    waiters tries again                                                    *
+*  - every operation also sweeps purgeStep buckets of its shard for expired *
+*    entries, so dead entries go away a little at a time without a global   *
+*    pass. purge() sweeps everything at once                                *
+****************************************************************************/
+template <typename K, typename V, typename Policy = atomicCount,
+          typename Hash = std::hash<K>, std::size_t Shards = 16>
+class weakValueCache {
+  static_assert(!std::is_same<Policy, nonAtomicCount>::value,
+                "weakValueCache is shared between threads, it needs atomic counts");
+  static_assert(Shards > 0 && Shards <= 0xFFFFFFFFu,
+                "Shards must fit into the 32 bits picking a shard");
+
+public:
+  using pointer = sharedPointer<V, Policy>;
+  // Buckets swept for expired entries by every operation on a shard
+  static constexpr std::size_t purgeStep = 2;
+
+  weakValueCache() = default;
+  weakValueCache(const weakValueCache &) = delete;
+  weakValueCache &operator=(const weakValueCache &) = delete;
+
+  // The live value for key, built by factory() (returning a pointer) if
+  // there is none. Concurrent misses on one key run factory only once
+  template <typename Factory>
+  pointer get_or_create(const K &key, Factory &&factory);
+  // The live value for key, empty if there is none (or it is being built)
+  pointer find(const K &key);
+  // Removes every expired entry, returns how many
+  std::size_t purge();
+  // Entries, expired ones not purged yet included
+  std::size_t size() const;
+
+private:
+  // A value being built, waited on by the other threads missing on its key
+  struct inflight {
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool done = false;
+    // Empty if the factory threw
+    pointer value;
+  };
+  struct entry {
+    weakPointer<V, Policy> value;
+    // Set while the value is being built
+    sharedPointer<inflight, Policy> pending;
+  };
+  // One lock and one map, on a cache line of its own
+  struct alignas(64) shard {
+    mutable std::mutex mutex;
+    std::unordered_map<K, entry, Hash> entries;
+    // Next bucket an incremental sweep looks at
+    std::size_t cursor = 0;
+  };
+
+  // Shard of key, picked from the high bits of the mixed hash. The low bits
+  // of Hash stay independent of the shard for the buckets of its map, even
+  // with an identity hash and a power of two Shards
+  shard &shard_for(const K &key);
+  // Erases expired entries of up to count buckets, to be called locked
+  static std::size_t sweep(shard &part, std::size_t count);
+  // Hands the result of a build to the entry and to the waiting threads
+  void finish(shard &part, const K &key,
+              const sharedPointer<inflight, Policy> &build, pointer value);
+
+  shard shards_[Shards];
+};
+
+template <typename K, typename V, typename Policy, typename Hash,
+          std::size_t Shards>
+typename weakValueCache<K, V, Policy, Hash, Shards>::shard &
+weakValueCache<K, V, Policy, Hash, Shards>::shard_for(const K &key) {
+  // Fibonacci hashing, the odd constant is 2^64 divided by the golden ratio
+  std::uint64_t mixed =
+      static_cast<std::uint64_t>(Hash()(key)) * 0x9E3779B97F4A7C15ull;
+  // Maps the top 32 bits onto [0, Shards) without a division
+  return shards_[((mixed >> 32) * Shards) >> 32];
+}
+
+template <typename K, typename V, typename Policy, typename Hash,
+          std::size_t Shards>
+template <typename Factory>
+typename weakValueCache<K, V, Policy, Hash, Shards>::pointer
+weakValueCache<K, V, Policy, Hash, Shards>::get_or_create(const K &key,
+                                                          Factory &&factory) {
+  shard &part = shard_for(key);
+  for (;;) {
+    sharedPointer<inflight, Policy> build;
+    sharedPointer<inflight, Policy> waitFor;
+    {
+      std::lock_guard<std::mutex> lock(part.mutex);
+      sweep(part, purgeStep);
+      entry &slot = part.entries[key];
+      if (slot.pending) {
+        waitFor = slot.pending;
+      } else if (pointer live = slot.value.lock()) {
+        return live;
+      } else {
+        // Missing or expired, this thread builds it
+        build = make_shared<inflight, Policy>();
+        slot.pending = build;
+      }
+    }
+    if (build) {
+      pointer value;
+      try {
+        value = factory();
+      } catch (...) {
+        finish(part, key, build, pointer());
+        throw;
+      }
+      finish(part, key, build, value);
+      return value;
+    }
+    std::unique_lock<std::mutex> lock(waitFor->mutex);
+    waitFor->ready.wait(lock, [&waitFor] { return waitFor->done; });
+    if (waitFor->value) {
+      return waitFor->value;
+    }
+    // The build failed, start over and possibly build it here
+  }
+}
+
+template <typename K, typename V, typename Policy, typename Hash,
+          std::size_t Shards>
+void weakValueCache<K, V, Policy, Hash, Shards>::finish(
+    shard &part, const K &key, const sharedPointer<inflight, Policy> &build,
+    pointer value) {
+  {
+    std::lock_guard<std::mutex> lock(part.mutex);
+    auto found = part.entries.find(key);
+    if (found != part.entries.end() && found->second.pending.get() == build.get()) {
+      if (value) {
+        found->second.value = value;
+        found->second.pending.reset();
+      } else {
+        part.entries.erase(found);
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(build->mutex);
+    build->value = std::move(value);
+    build->done = true;
+  }
+  build->ready.notify_all();
+}
+
+template <typename K, typename V, typename Policy, typename Hash,
+          std::size_t Shards>
+typename weakValueCache<K, V, Policy, Hash, Shards>::pointer
+weakValueCache<K, V, Policy, Hash, Shards>::find(const K &key) {
+  shard &part = shard_for(key);
+  std::lock_guard<std::mutex> lock(part.mutex);
+  sweep(part, purgeStep);
+  auto found = part.entries.find(key);
+  if (found == part.entries.end() || found->second.pending) {
+    return pointer();
+  }
+  return found->second.value.lock();
+}
+
+template <typename K, typename V, typename Policy, typename Hash,
+          std::size_t Shards>
+std::size_t weakValueCache<K, V, Policy, Hash, Shards>::purge() {
+  std::size_t removed = 0;
+  for (shard &part : shards_) {
+    std::lock_guard<std::mutex> lock(part.mutex);
+    removed += sweep(part, part.entries.bucket_count());
+  }
+  return removed;
+}
+
+template <typename K, typename V, typename Policy, typename Hash,
+          std::size_t Shards>
+std::size_t weakValueCache<K, V, Policy, Hash, Shards>::size() const {
+  std::size_t total = 0;
+  for (const shard &part : shards_) {
+    std::lock_guard<std::mutex> lock(part.mutex);
+    total += part.entries.size();
+  }
+  return total;
+}
+
+template <typename K, typename V, typename Policy, typename Hash,
+          std::size_t Shards>
+std::size_t weakValueCache<K, V, Policy, Hash, Shards>::sweep(shard &part,
+                                                             std::size_t count) {
+  std::size_t buckets = part.entries.bucket_count();
+  std::vector<K> expired;
+  for (std::size_t i = 0; i < count && i < buckets; ++i) {
+    std::size_t bucket = part.cursor++ % buckets;
+    for (auto each = part.entries.begin(bucket); each != part.entries.end(bucket);
+         ++each) {
+      if (!each->second.pending && each->second.value.expired()) {
+        expired.push_back(each->first);
+      }
+    }
+  }
+  for (const K &key : expired) {
+    part.entries.erase(key);
+  }
+  return expired.size();
+}
+
+} // namespace eds
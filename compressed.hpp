@@ -0,0 +1,174 @@
+#pragma once
+#include "unique.hpp"
+#include <atomic>  // For std::atomic
+#include <cstddef> // For std::size_t, std::nullptr_t, std::max_align_t
+#include <cstdint> // For std::uint32_t, std::uintptr_t
+#include <new>     // For std::bad_alloc, placement new
+#include <utility> // For std::forward
+
+namespace eds {
+
+/****************************************************************************
+*Compressed pointers for big in-memory graphs. Objects live in an arena, a  *
+*region attached once at a fixed base, and a compressedPointer stores their *
+*position as a 32-bit offset from that base instead of a full address:      *
+*  stored = ((address - base) >> Shift) + 1, 0 meaning null                 *
+*Shift defaults to log2(alignof(T)), since those low bits are always zero.  *
+*That way an int edge reaches 16 GiB of arena in 4 bytes and an 8-aligned   *
+*node 32 GiB. Decoding is a shift and an add on every dereference.          *
+*The owning version is a plain uniquePointer whose deleter, arenaDelete,    *
+*names compressedPointer as its pointer type. It keeps uniquePointer's      *
+*get(), operator->, operator*, reset() and release(), and with the          *
+*stateless deleter it is 4 bytes wide.                                      *
+*The arena hands out memory with a lock-free bump pointer and never reuses  *
+*it: the objects' destructors run as usual, the memory comes back when the  *
+*whole region is dropped, which suits graphs that are torn down together.   *
+****************************************************************************/
+
+// Region compressed pointers of one Tag point into, a new Tag is a new arena
+template <typename Tag = void> class offsetArena {
+public:
+  // Makes [base, base + bytes) the arena, base must be aligned to
+  // std::max_align_t. Attach before any pointer of this arena is made
+  static void attach(void *base, std::size_t bytes) noexcept;
+  static char *base() noexcept { return base_; }
+  // Bytes handed out so far
+  static std::size_t used() noexcept {
+    return used_.load(std::memory_order_relaxed);
+  }
+  // Memory for an object out of the arena, throws std::bad_alloc once full
+  static void *allocate(std::size_t bytes, std::size_t alignment);
+
+private:
+  static inline char *base_ = nullptr;
+  static inline std::size_t size_ = 0;
+  static inline std::atomic<std::size_t> used_{0};
+};
+
+template <typename Tag>
+void offsetArena<Tag>::attach(void *base, std::size_t bytes) noexcept {
+  base_ = static_cast<char *>(base);
+  size_ = bytes;
+  used_.store(0, std::memory_order_relaxed);
+}
+
+template <typename Tag>
+void *offsetArena<Tag>::allocate(std::size_t bytes, std::size_t alignment) {
+  std::size_t used = used_.load(std::memory_order_relaxed);
+  std::size_t start;
+  do {
+    start = (used + alignment - 1) & ~(alignment - 1);
+    if (start > size_ || bytes > size_ - start) {
+      throw std::bad_alloc();
+    }
+  } while (!used_.compare_exchange_weak(used, start + bytes,
+                                        std::memory_order_relaxed));
+  return base_ + start;
+}
+
+// log2 of T's alignment, the bits every offset to a T has zero at the bottom
+template <typename T> constexpr unsigned alignment_shift() noexcept {
+  unsigned shift = 0;
+  while ((std::size_t(1) << (shift + 1)) <= alignof(T)) {
+    ++shift;
+  }
+  return shift;
+}
+
+// Non-owning 32-bit pointer into an offsetArena, decoded on every access
+template <typename T, typename Arena = offsetArena<>,
+          unsigned Shift = alignment_shift<T>()>
+class compressedPointer {
+  static_assert((std::size_t(1) << Shift) <= alignof(std::max_align_t),
+                "the arena base is only aligned to std::max_align_t");
+
+public:
+  // Null pointer
+  compressedPointer() noexcept : offset_(0) {}
+  compressedPointer(std::nullptr_t) noexcept : offset_(0) {}
+  // Encodes ptr, which must point into the arena (see representable)
+  explicit compressedPointer(T *ptr) noexcept : offset_(encode(ptr)) {}
+  // True if ptr can be stored, inside the reach of 32 bits and aligned
+  static bool representable(const T *ptr) noexcept;
+  // Decoded address
+  T *get() const noexcept;
+  T &operator*() const noexcept { return *get(); }
+  T *operator->() const noexcept { return get(); }
+  explicit operator bool() const noexcept { return offset_ != 0; }
+  // Stored 32-bit value, 0 for null
+  std::uint32_t offset() const noexcept { return offset_; }
+
+  friend bool operator==(compressedPointer one, compressedPointer other) noexcept {
+    return one.offset_ == other.offset_;
+  }
+  friend bool operator!=(compressedPointer one, compressedPointer other) noexcept {
+    return one.offset_ != other.offset_;
+  }
+
+private:
+  static std::uint32_t encode(const T *ptr) noexcept;
+
+  std::uint32_t offset_;
+};
+
+template <typename T, typename Arena, unsigned Shift>
+bool compressedPointer<T, Arena, Shift>::representable(const T *ptr) noexcept {
+  if (ptr == nullptr) {
+    return true;
+  }
+  std::uintptr_t address = reinterpret_cast<std::uintptr_t>(ptr);
+  std::uintptr_t base = reinterpret_cast<std::uintptr_t>(Arena::base());
+  if (address < base) {
+    return false;
+  }
+  std::uintptr_t distance = address - base;
+  return (distance & ((std::uintptr_t(1) << Shift) - 1)) == 0 &&
+         (distance >> Shift) < std::uintptr_t(0xffffffff);
+}
+
+template <typename T, typename Arena, unsigned Shift>
+std::uint32_t compressedPointer<T, Arena, Shift>::encode(const T *ptr) noexcept {
+  if (ptr == nullptr) {
+    return 0;
+  }
+  std::uintptr_t distance = static_cast<std::uintptr_t>(
+      reinterpret_cast<const char *>(ptr) - Arena::base());
+  return static_cast<std::uint32_t>(distance >> Shift) + 1;
+}
+
+template <typename T, typename Arena, unsigned Shift>
+T *compressedPointer<T, Arena, Shift>::get() const noexcept {
+  if (offset_ == 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<T *>(
+      Arena::base() + (static_cast<std::uintptr_t>(offset_ - 1) << Shift));
+}
+
+// Deleter of arena objects, runs the destructor and leaves the memory to the
+// arena. Its pointer type turns uniquePointer into a 4-byte owner
+template <typename T, typename Arena = offsetArena<>,
+          unsigned Shift = alignment_shift<T>()>
+struct arenaDelete {
+  using pointer = compressedPointer<T, Arena, Shift>;
+  void operator()(pointer ptr) const noexcept { ptr.get()->~T(); }
+};
+
+// Owning compressed pointer, the surface of uniquePointer in 32 bits
+template <typename T, typename Arena = offsetArena<>>
+using compressedUniquePointer = uniquePointer<T, arenaDelete<T, Arena>>;
+
+// Builds a T in the arena and hands out its compressed owner
+template <typename T, typename Arena = offsetArena<>, typename... Args>
+compressedUniquePointer<T, Arena> make_compressed_unique(Args &&...args) {
+  using pointer = typename arenaDelete<T, Arena>::pointer;
+  void *memory = Arena::allocate(sizeof(T), alignof(T));
+  if (!pointer::representable(static_cast<T *>(memory))) {
+    // Past what 32 bits reach from the base, the arena is too big
+    throw std::bad_alloc();
+  }
+  T *object = ::new (memory) T(std::forward<Args>(args)...);
+  return compressedUniquePointer<T, Arena>(pointer(object));
+}
+
+} // namespace eds
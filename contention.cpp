@@ -0,0 +1,392 @@
+/********************************************************
+ *                                                      *
+ *      Contention and scaling benchmark for the        *
+ *      reference counts of the smart pointers          *
+ *                                                      *
+ ********************************************************/
+
+// Usage: ./contention [--csv] [--ops N] [--threads N]
+// Sweeps the thread count from 1 to std::thread::hardware_concurrency()
+// (or --threads) and reports throughput and p50/p99/p999 latency of:
+//   - N threads copying and dropping the same sharedPointer
+//   - one producer fanning copies out to N-1 consumers through queues (N is
+//     at least 2 there, the producer counts as a thread)
+//   - N threads calling lock() on the same weakPointer
+// and checks whether two counters on the same cache line slow each other
+// down (false sharing). Latencies are per operation and include the cost of
+// reading the clock. --csv prints
+//   scenario,impl,threads,mops_per_s,p50_ns,p99_ns,p999_ns
+// lines instead of the readable report. The false sharing check ends with a
+// row whose impl is verdict=false_sharing, verdict=no_false_sharing or
+// verdict=inconclusive and whose mops_per_s is the slowdown ratio.
+
+#include "biased.hpp"
+#include "shared.hpp"
+#include "weak.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+using benchClock = std::chrono::steady_clock;
+
+// Keeps the compiler from dropping the measured copies
+template <typename T> void keep(T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Outcome of one scenario at one thread count
+struct result {
+  double mops;
+  double p50;
+  double p99;
+  double p999;
+};
+
+// Throughput of all threads together and the latency percentiles of every
+// single operation any of them timed
+result summarize(std::vector<std::vector<float>> &latencies,
+                 benchClock::duration wall) {
+  std::vector<float> all;
+  for (auto &perThread : latencies) {
+    all.insert(all.end(), perThread.begin(), perThread.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto at = [&all](double fraction) {
+    return all.empty() ? 0.0 : double(all[std::size_t(fraction * (all.size() - 1))]);
+  };
+  double seconds = std::chrono::duration<double>(wall).count();
+  return {all.size() / seconds / 1e6, at(0.50), at(0.99), at(0.999)};
+}
+
+// Starts threads threads together and times ops calls of body(thread) on each
+template <typename Body> result run_threads(int threads, long ops, Body body) {
+  std::vector<std::vector<float>> latencies(threads);
+  std::atomic<int> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::vector<float> &mine = latencies[t];
+      mine.reserve(ops);
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (long i = 0; i < ops; ++i) {
+        auto start = benchClock::now();
+        body(t);
+        auto stop = benchClock::now();
+        mine.push_back(std::chrono::duration<float, std::nano>(stop - start).count());
+      }
+    });
+  }
+  while (ready.load() != threads) {
+    std::this_thread::yield();
+  }
+  auto start = benchClock::now();
+  go.store(true, std::memory_order_release);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return summarize(latencies, benchClock::now() - start);
+}
+
+// N threads copying and dropping one shared handle
+template <typename Shared, typename Make>
+result copy_contention(int threads, long ops, Make make) {
+  Shared source = make();
+  return run_threads(threads, ops, [&source](int) {
+    Shared copy(source);
+    keep(copy);
+  });
+}
+
+// N threads locking one weak handle
+template <typename Shared, typename Weak, typename Make>
+result lock_contention(int threads, long ops, Make make) {
+  Shared owner = make();
+  Weak observer = owner;
+  return run_threads(threads, ops, [&observer](int) {
+    Shared locked = observer.lock();
+    keep(locked);
+  });
+}
+
+// Bounded single-producer single-consumer ring of handles, each entry also
+// carries the time it was pushed so the consumer can time the whole handoff
+template <typename Handle> class spscRing {
+public:
+  bool push(Handle handle) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == capacity) {
+      return false;
+    }
+    slots_[tail % capacity] = {std::move(handle), benchClock::now()};
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+  bool pop(benchClock::time_point &pushed) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slot &entry = slots_[head % capacity];
+    // Dropping the handle is part of what we measure
+    entry.handle = Handle();
+    pushed = entry.pushed;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static constexpr std::size_t capacity = 1024;
+  struct slot {
+    Handle handle;
+    benchClock::time_point pushed;
+  };
+  slot slots_[capacity];
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+// One producer hands copies of the same object to consumers round robin,
+// the consumers drop them. Latency is push to drop
+template <typename Shared, typename Make>
+result fan_out(int consumers, long ops, Make make) {
+  Shared source = make();
+  std::vector<std::unique_ptr<spscRing<Shared>>> queues;
+  for (int c = 0; c < consumers; ++c) {
+    queues.push_back(std::make_unique<spscRing<Shared>>());
+  }
+  std::vector<std::vector<float>> latencies(consumers);
+  std::vector<std::thread> workers;
+  auto start = benchClock::now();
+  for (int c = 0; c < consumers; ++c) {
+    workers.emplace_back([&, c] {
+      std::vector<float> &mine = latencies[c];
+      mine.reserve(ops);
+      benchClock::time_point pushed;
+      for (long received = 0; received < ops;) {
+        if (queues[c]->pop(pushed)) {
+          mine.push_back(std::chrono::duration<float, std::nano>(
+                             benchClock::now() - pushed)
+                             .count());
+          ++received;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (long i = 0; i < ops; ++i) {
+    for (int c = 0; c < consumers; ++c) {
+      while (!queues[c]->push(source)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  return summarize(latencies, benchClock::now() - start);
+}
+
+/****************************************************************************
+*False sharing check: two threads each copy their own object, once with both *
+*control blocks on the same cache line and once with them 128 bytes apart.  *
+*The blocks are placed with a monotonic arena, which hands out memory in    *
+*order. If the shared line is clearly slower the counters are fighting over *
+*it even though no object is shared.                                        *
+****************************************************************************/
+result neighbours(long ops, std::size_t gap) {
+  alignas(128) static char buffer[4096];
+  std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer),
+                                            std::pmr::null_memory_resource());
+  std::pmr::polymorphic_allocator<int> alloc(&arena);
+  auto first = eds::allocate_shared<int, eds::atomicCount>(alloc, 1);
+  if (gap != 0) {
+    (void)arena.allocate(gap, 1);
+  }
+  auto second = eds::allocate_shared<int, eds::atomicCount>(alloc, 2);
+  eds::sharedPointer<int, eds::atomicCount> *sources[] = {&first, &second};
+  return run_threads(2, ops, [&sources](int t) {
+    eds::sharedPointer<int, eds::atomicCount> copy(*sources[t]);
+    keep(copy);
+  });
+}
+
+// Prints the results either as a readable report or as CSV
+class reporter {
+public:
+  explicit reporter(bool csv) : csv_(csv) {
+    if (csv_) {
+      std::cout << "scenario,impl,threads,mops_per_s,p50_ns,p99_ns,p999_ns"
+                << std::endl;
+    }
+  }
+  void section(const std::string &title) {
+    scenario_ = title;
+    first_ = true;
+    if (csv_) {
+      return;
+    }
+    std::cout << "*********************************************************"
+              << std::endl;
+    std::cout << std::endl << "\t\t" << title << std::endl;
+    std::cout << std::endl
+              << "*********************************************************"
+              << std::endl;
+  }
+  void item(const std::string &impl) {
+    impl_ = impl;
+    if (csv_) {
+      return;
+    }
+    if (!first_) {
+      std::cout << "--------------------------------------------------------------------------------------------------------------"
+                << std::endl;
+    }
+    first_ = false;
+    std::cout << impl << std::endl;
+  }
+  void row(int threads, result outcome) {
+    if (csv_) {
+      std::cout << scenario_ << ',' << impl_ << ',' << threads << ','
+                << outcome.mops << ',' << outcome.p50 << ',' << outcome.p99
+                << ',' << outcome.p999 << std::endl;
+      return;
+    }
+    std::cout << "  " << threads << " threads: " << outcome.mops
+              << " Mops/s, p50 " << outcome.p50 << " ns, p99 " << outcome.p99
+              << " ns, p999 " << outcome.p999 << " ns" << std::endl;
+  }
+  void note(const std::string &text) {
+    if (!csv_) {
+      std::cout << text << std::endl;
+    }
+  }
+  // Conclusion of the current scenario. In CSV it is a row whose impl is
+  // verdict=code and whose mops_per_s column holds ratio
+  void verdict(const std::string &code, double ratio, const std::string &text) {
+    if (csv_) {
+      std::cout << scenario_ << ",verdict=" << code << ",," << ratio << ",,,"
+                << std::endl;
+      return;
+    }
+    note(text);
+  }
+
+private:
+  bool csv_;
+  bool first_ = true;
+  std::string scenario_;
+  std::string impl_;
+};
+
+int main(int argc, char **argv) {
+  bool csv = false;
+  long ops = 200000;
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--csv") == 0) {
+      csv = true;
+    } else if (std::strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+      ops = std::atol(argv[++i]);
+      if (ops < 1) {
+        std::cerr << "--ops needs a positive count" << std::endl;
+        return 1;
+      }
+    } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      maxThreads = std::atoi(argv[++i]);
+      if (maxThreads < 1) {
+        std::cerr << "--threads needs a positive count" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--csv] [--ops N] [--threads N]"
+                << std::endl;
+      return 1;
+    }
+  }
+  reporter report(csv);
+
+  using atomicShared = eds::sharedPointer<int, eds::atomicCount>;
+  using biasedShared = eds::sharedPointer<int, eds::biasedCount>;
+  auto makeAtomic = [] { return eds::make_shared<int, eds::atomicCount>(1); };
+  auto makeBiased = [] { return eds::make_shared<int, eds::biasedCount>(1); };
+  auto makeStd = [] { return std::make_shared<int>(1); };
+
+  report.section("Copy + drop of one sharedPointer");
+  report.item("eds atomicCount");
+  for (int threads = 1; threads <= maxThreads; ++threads) {
+    report.row(threads, copy_contention<atomicShared>(threads, ops, makeAtomic));
+  }
+  report.item("eds biasedCount");
+  for (int threads = 1; threads <= maxThreads; ++threads) {
+    report.row(threads, copy_contention<biasedShared>(threads, ops, makeBiased));
+  }
+  report.item("std::shared_ptr");
+  for (int threads = 1; threads <= maxThreads; ++threads) {
+    report.row(threads,
+               copy_contention<std::shared_ptr<int>>(threads, ops, makeStd));
+  }
+
+  report.section("Fan-out handoff through queues");
+  report.note("1 producer and threads - 1 consumers, at least 2 threads");
+  // The producer is a thread too, rows count it
+  int fanOutThreads = std::max(2, maxThreads);
+  report.item("eds atomicCount");
+  for (int threads = 2; threads <= fanOutThreads; ++threads) {
+    report.row(threads, fan_out<atomicShared>(threads - 1, ops, makeAtomic));
+  }
+  report.item("std::shared_ptr");
+  for (int threads = 2; threads <= fanOutThreads; ++threads) {
+    report.row(threads,
+               fan_out<std::shared_ptr<int>>(threads - 1, ops, makeStd));
+  }
+
+  report.section("lock() on one weakPointer");
+  report.item("eds atomicCount");
+  for (int threads = 1; threads <= maxThreads; ++threads) {
+    report.row(threads,
+               lock_contention<atomicShared,
+                               eds::weakPointer<int, eds::atomicCount>>(
+                   threads, ops, makeAtomic));
+  }
+  report.item("std::shared_ptr");
+  for (int threads = 1; threads <= maxThreads; ++threads) {
+    report.row(threads,
+               lock_contention<std::shared_ptr<int>, std::weak_ptr<int>>(
+                   threads, ops, makeStd));
+  }
+
+  report.section("False sharing between neighbouring control blocks");
+  report.item("same cache line");
+  result together = neighbours(ops, 0);
+  report.row(2, together);
+  report.item("128 bytes apart");
+  result apart = neighbours(ops, 128);
+  report.row(2, apart);
+  if (maxThreads < 2 || std::thread::hardware_concurrency() < 2) {
+    report.verdict("inconclusive", 0,
+                   "Only one hardware thread, the two threads never run at the "
+                   "same time and nothing can be concluded");
+  } else if (together.mops < apart.mops / 1.5) {
+    report.verdict("false_sharing", apart.mops / together.mops,
+                   "FALSE SHARING: counters on the same cache line cost " +
+                       std::to_string(apart.mops / together.mops) +
+                       "x throughput");
+  } else {
+    report.verdict("no_false_sharing", apart.mops / together.mops,
+                   "No false sharing measured");
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "shared.hpp"
+#include <cstddef> // For std::size_t, std::nullptr_t
+#include <utility> // For std::move, std::forward
+
+namespace eds {
+
+/****************************************************************************
+*cowPointer: copy-on-write over a sharedPointer. Copying a cowPointer only  *
+*shares the object, so snapshots cost one count increment. Reading goes     *
+*through const access and never copies. write() hands out a mutable         *
+*reference, cloning the object first unless this cowPointer is its only     *
+*owner and no weakPointer observes it (sharedPointer::unique()).            *
+*With atomicCount the uniqueness check loads the counts with acquire, so    *
+*copies dropped on other threads have finished with the object before it is *
+*written to in place. Each cowPointer itself is used by one thread at a     *
+*time, like a sharedPointer.                                                *
+*A reference from write() is only good until the next copy of this          *
+*cowPointer is made.                                                        *
+****************************************************************************/
+template <typename T, typename Policy = nonAtomicCount> class cowPointer {
+public:
+  // Default constructor, owns nothing
+  cowPointer() noexcept = default;
+  // Constructor for nullptr
+  cowPointer(std::nullptr_t) noexcept {}
+  // Takes over value, any other owner of it keeps seeing the original
+  explicit cowPointer(sharedPointer<T, Policy> value) noexcept
+      : value_(std::move(value)) {}
+  // Function to get the raw pointer, read-only
+  const T *get() const noexcept { return value_.get(); }
+  // Dereference operator, read-only
+  const T &operator*() const noexcept { return *value_; }
+  // Member access operator, read-only
+  const T *operator->() const noexcept { return value_.get(); }
+  // Explicit conversion operator to bool
+  explicit operator bool() const noexcept { return static_cast<bool>(value_); }
+  // Number of cowPointers (and snapshots) sharing the object
+  std::size_t use_count() const noexcept { return value_.use_count(); }
+  // Mutable access, clones the object first if anybody else shares it. Only
+  // for a non-empty cowPointer
+  T &write();
+  // Read-only owner of the current version
+  sharedPointer<const T, Policy> snapshot() const noexcept {
+    return static_pointer_cast<const T>(value_);
+  }
+  // Swap function to exchange the contents with another cowPointer
+  void swap(cowPointer &other) noexcept { value_.swap(other.value_); }
+
+private:
+  sharedPointer<T, Policy> value_;
+};
+
+// Mutable access
+template <typename T, typename Policy> T &cowPointer<T, Policy>::write() {
+  if (!value_.unique()) {
+    // Copied from the const object, the shared version is never touched
+    value_ = make_shared<T, Policy>(static_cast<const T &>(*value_));
+  }
+  return *value_;
+}
+
+// Free function swap that calls upon the swap method of cowPointer
+template <typename T, typename Policy>
+void swap(cowPointer<T, Policy> &one, cowPointer<T, Policy> &other) noexcept {
+  one.swap(other);
+}
+
+// Make function, the object lives inside its control block
+template <typename T, typename Policy = nonAtomicCount, typename... Args>
+cowPointer<T, Policy> make_cow(Args &&...args) {
+  return cowPointer<T, Policy>(
+      make_shared<T, Policy>(std::forward<Args>(args)...));
+}
+
+} // namespace eds
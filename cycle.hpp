@@ -0,0 +1,398 @@
+#pragma once
+#include "shared.hpp"
+#include "weak.hpp"
+#include <cstddef>       // For std::size_t, std::ptrdiff_t
+#include <limits>        // For std::numeric_limits
+#include <type_traits>   // For std::is_convertible
+#include <unordered_map> // For the index of tracked objects
+#include <utility>       // For std::move
+#include <vector>        // For the tracked objects and the pass state
+
+namespace eds {
+
+/****************************************************************************
+*Cycle collection for sharedPointer graphs. Reference counting alone never  *
+*frees a cycle. Objects that derive from traceable<Policy> implement        *
+*trace(tracer) and hand each outgoing sharedPointer edge to the tracer. A   *
+*cycleCollector tracks them through weakPointers, so tracking never keeps   *
+*an object alive. Objects reached from tracked ones are tracked as they are *
+*found, so tracking a single member of a structure is enough.               *
+*A pass does trial deletion, like CPython's collector:                      *
+*  scan   each object starts with its strong count, and every edge between  *
+*         tracked objects is subtracted from its target. Whatever is left   *
+*         comes from outside the tracked graph                              *
+*  mark   everything reachable from an object with outside references is    *
+*         alive                                                             *
+*  sweep  the rest are candidates. They are traced once more and only a set *
+*         whose strong counts all come from edges inside the set is freed,  *
+*         by resetting its edges                                            *
+*collect_step(budget) handles at most budget objects per call while it      *
+*scans, marks, gathers the candidates or compacts, so a pass can be spread  *
+*over many short pauses while the program keeps mutating the graph in       *
+*between. The sweep rechecks its candidates, so stale scan results only     *
+*leave garbage for the next pass and never free a live object. The sweep    *
+*itself is one step that traces the candidates again, in time proportional  *
+*to them and their edges: the garbage, plus whatever changed during the     *
+*pass.                                                                      *
+*The tracking weakPointers keep the blocks of make_shared objects           *
+*allocated, object storage included. The sweep drops them for the objects   *
+*it frees, the compaction after it for those that died otherwise.           *
+*Steps must not run while another thread touches the tracked graph, and no  *
+*borrowed view into it may be held across one.                              *
+****************************************************************************/
+
+template <typename Policy = nonAtomicCount> class cycleCollector;
+template <typename Policy = nonAtomicCount> class cycleTracer;
+
+// Base of objects whose outgoing sharedPointer edges the collector can see
+template <typename Policy = nonAtomicCount> class traceable {
+public:
+  // Hands every sharedPointer member to tracer, as in tracer(next_)
+  virtual void trace(cycleTracer<Policy> &tracer) = 0;
+
+protected:
+  traceable() = default;
+  traceable(const traceable &) = default;
+  traceable &operator=(const traceable &) = default;
+  virtual ~traceable() = default;
+};
+
+// Visitor passed to traceable::trace, records edges or resets them
+template <typename Policy> class cycleTracer {
+public:
+  // Edge from the traced object
+  template <typename U> void operator()(sharedPointer<U, Policy> &edge);
+
+private:
+  friend class cycleCollector<Policy>;
+  cycleTracer(cycleCollector<Policy> &collector, std::vector<std::size_t> *edges)
+      : collector_(collector), edges_(edges) {}
+
+  cycleCollector<Policy> &collector_;
+  // Where the targets are recorded, resets the edges instead when null
+  std::vector<std::size_t> *edges_;
+};
+
+template <typename Policy> class cycleCollector {
+public:
+  using pointer = sharedPointer<traceable<Policy>, Policy>;
+
+  cycleCollector() = default;
+  cycleCollector(const cycleCollector &) = delete;
+  cycleCollector &operator=(const cycleCollector &) = delete;
+
+  // Starts tracking object (and later whatever it reaches)
+  template <typename T> void track(const sharedPointer<T, Policy> &object);
+  // Scans, marks, gathers or compacts up to budget objects, or sweeps.
+  // Returns the number of objects freed, which is only non-zero for a sweep
+  std::size_t collect_step(std::size_t budget);
+  // Runs a whole pass (finishing the current one if any), compaction
+  // included. Returns the number of objects freed
+  std::size_t collect();
+  // Tracked objects, dead ones not yet compacted away included
+  std::size_t tracked() const noexcept { return nodes_.size(); }
+  // True between the first step of a pass and the end of its compaction
+  bool collecting() const noexcept { return phase_ != phase::idle; }
+
+private:
+  friend class cycleTracer<Policy>;
+
+  enum class phase { idle, scan, mark, gather, sweep, compact };
+  struct node {
+    weakPointer<traceable<Policy>, Policy> object;
+    const traceable<Policy> *address;
+  };
+
+  // Index of the node for object, tracking it if it is new
+  std::size_t node_of(const pointer &object);
+  // Targets of object's edges
+  std::vector<std::size_t> edges_of(traceable<Policy> &object);
+  void scan(std::size_t i);
+  // Takes the objects tracked since the pass started into it
+  void extend_pass();
+  // Frees the candidates whose counts all come from inside, returns how many
+  std::size_t sweep();
+  // Drops the nodes of dead objects among the next budget ones
+  void compact(std::size_t budget);
+
+  std::vector<node> nodes_;
+  std::unordered_map<const traceable<Policy> *, std::size_t> index_;
+  // State of the current pass, over the nodes tracked before its mark phase
+  phase phase_ = phase::idle;
+  std::size_t passEnd_ = 0;
+  std::size_t cursor_ = 0;
+  // References from outside the tracked graph. From the gather phase on, the
+  // candidate slot of each node instead, -1 for the others
+  std::vector<std::ptrdiff_t> external_;
+  std::vector<std::vector<std::size_t>> edges_;
+  std::vector<bool> alive_;
+  std::vector<bool> reachable_;
+  std::vector<std::size_t> work_;
+  // Nodes neither reached nor dead at the end of the mark phase
+  std::vector<std::size_t> candidates_;
+};
+
+template <typename Policy>
+template <typename U>
+void cycleTracer<Policy>::operator()(sharedPointer<U, Policy> &edge) {
+  if (edges_ == nullptr) {
+    edge.reset();
+    return;
+  }
+  if constexpr (std::is_convertible<U *, traceable<Policy> *>::value) {
+    if (edge) {
+      edges_->push_back(
+          collector_.node_of(static_pointer_cast<traceable<Policy>>(edge)));
+    }
+  }
+}
+
+template <typename Policy>
+template <typename T>
+void cycleCollector<Policy>::track(const sharedPointer<T, Policy> &object) {
+  if (object) {
+    node_of(static_pointer_cast<traceable<Policy>>(object));
+  }
+}
+
+template <typename Policy>
+std::size_t cycleCollector<Policy>::node_of(const pointer &object) {
+  const traceable<Policy> *address = object.get();
+  auto found = index_.find(address);
+  if (found != index_.end()) {
+    node &known = nodes_[found->second];
+    if (known.object.expired()) {
+      // A new object at the address of a dead one
+      known.object = object;
+    }
+    return found->second;
+  }
+  nodes_.push_back({object, address});
+  index_.emplace(address, nodes_.size() - 1);
+  return nodes_.size() - 1;
+}
+
+template <typename Policy>
+std::vector<std::size_t>
+cycleCollector<Policy>::edges_of(traceable<Policy> &object) {
+  std::vector<std::size_t> edges;
+  cycleTracer<Policy> tracer(*this, &edges);
+  object.trace(tracer);
+  return edges;
+}
+
+template <typename Policy>
+std::size_t cycleCollector<Policy>::collect_step(std::size_t budget) {
+  if (phase_ == phase::idle) {
+    passEnd_ = 0;
+    cursor_ = 0;
+    external_.clear();
+    edges_.clear();
+    alive_.clear();
+    reachable_.clear();
+    work_.clear();
+    candidates_.clear();
+    phase_ = phase::scan;
+  }
+  if (budget == 0) {
+    budget = 1;
+  }
+  if (phase_ == phase::scan) {
+    extend_pass();
+    for (; cursor_ < passEnd_ && budget != 0; ++cursor_, --budget) {
+      scan(cursor_);
+    }
+    if (cursor_ == passEnd_) {
+      cursor_ = 0;
+      phase_ = phase::mark;
+    }
+  }
+  if (phase_ == phase::mark) {
+    while (budget != 0 && (cursor_ < passEnd_ || !work_.empty())) {
+      --budget;
+      std::size_t i;
+      if (!work_.empty()) {
+        i = work_.back();
+        work_.pop_back();
+      } else {
+        // Roots first: objects with references from outside
+        i = cursor_++;
+        if (!alive_[i] || reachable_[i] || external_[i] <= 0) {
+          continue;
+        }
+        reachable_[i] = true;
+      }
+      for (std::size_t j : edges_[i]) {
+        if (j < passEnd_ && !reachable_[j]) {
+          reachable_[j] = true;
+          work_.push_back(j);
+        }
+      }
+    }
+    if (cursor_ == passEnd_ && work_.empty()) {
+      cursor_ = 0;
+      phase_ = phase::gather;
+    }
+  }
+  if (phase_ == phase::gather) {
+    for (; cursor_ < passEnd_ && budget != 0; ++cursor_, --budget) {
+      if (alive_[cursor_] && !reachable_[cursor_]) {
+        external_[cursor_] = static_cast<std::ptrdiff_t>(candidates_.size());
+        candidates_.push_back(cursor_);
+      } else {
+        external_[cursor_] = -1;
+      }
+    }
+    if (cursor_ == passEnd_) {
+      phase_ = phase::sweep;
+      // The sweep gets a step of its own
+      return 0;
+    }
+  }
+  if (phase_ == phase::sweep) {
+    std::size_t freed = sweep();
+    cursor_ = 0;
+    phase_ = phase::compact;
+    return freed;
+  }
+  if (phase_ == phase::compact) {
+    compact(budget);
+  }
+  return 0;
+}
+
+template <typename Policy> std::size_t cycleCollector<Policy>::collect() {
+  std::size_t freed = 0;
+  do {
+    freed += collect_step(std::numeric_limits<std::size_t>::max());
+  } while (phase_ != phase::idle);
+  return freed;
+}
+
+template <typename Policy> void cycleCollector<Policy>::scan(std::size_t i) {
+  pointer object = nodes_[i].object.lock();
+  if (!object) {
+    return;
+  }
+  alive_[i] = true;
+  // Not counting the reference just taken
+  external_[i] += static_cast<std::ptrdiff_t>(object.use_count()) - 1;
+  edges_[i] = edges_of(*object);
+  // Objects found through the edges are scanned in this pass as well
+  extend_pass();
+  for (std::size_t j : edges_[i]) {
+    if (j < passEnd_) {
+      --external_[j];
+    }
+  }
+}
+
+template <typename Policy> void cycleCollector<Policy>::extend_pass() {
+  if (nodes_.size() > passEnd_) {
+    passEnd_ = nodes_.size();
+    external_.resize(passEnd_, 0);
+    edges_.resize(passEnd_);
+    alive_.resize(passEnd_, false);
+    reachable_.resize(passEnd_, false);
+  }
+}
+
+template <typename Policy> std::size_t cycleCollector<Policy>::sweep() {
+  std::size_t count = candidates_.size();
+  // Candidates held alive while they are checked and cleared, traced again
+  // as the graph may have changed since the scan
+  std::vector<pointer> held(count);
+  std::vector<std::vector<std::size_t>> edges(count);
+  for (std::size_t k = 0; k < count; ++k) {
+    held[k] = nodes_[candidates_[k]].object.lock();
+    if (held[k]) {
+      edges[k] = edges_of(*held[k]);
+    }
+  }
+  // Slot of the live candidate at node j, or count
+  auto slot = [&](std::size_t j) {
+    if (j >= passEnd_ || external_[j] < 0) {
+      return count;
+    }
+    std::size_t k = static_cast<std::size_t>(external_[j]);
+    return held[k] ? k : count;
+  };
+  // References to each candidate from the edges of the others
+  std::vector<std::size_t> internal(count, 0);
+  for (std::size_t k = 0; k < count; ++k) {
+    for (std::size_t j : edges[k]) {
+      std::size_t target = slot(j);
+      if (target != count) {
+        ++internal[target];
+      }
+    }
+  }
+  // Drops candidates with owners outside the set, and with them their edges,
+  // until the rest is closed. Every candidate is dropped at most once
+  std::vector<bool> inside(count, false);
+  std::vector<std::size_t> dropped;
+  for (std::size_t k = 0; k < count; ++k) {
+    if (held[k]) {
+      inside[k] = true;
+      if (held[k].use_count() - 1 != internal[k]) {
+        dropped.push_back(k);
+      }
+    }
+  }
+  while (!dropped.empty()) {
+    std::size_t k = dropped.back();
+    dropped.pop_back();
+    if (!inside[k]) {
+      continue;
+    }
+    inside[k] = false;
+    for (std::size_t j : edges[k]) {
+      std::size_t target = slot(j);
+      if (target != count && inside[target]) {
+        // Was closed or already queued, either way it goes now
+        --internal[target];
+        dropped.push_back(target);
+      }
+    }
+  }
+  std::size_t freed = 0;
+  for (std::size_t k = 0; k < count; ++k) {
+    if (inside[k]) {
+      cycleTracer<Policy> clearing(*this, nullptr);
+      held[k]->trace(clearing);
+      ++freed;
+    }
+  }
+  // The last references, the freed objects are destroyed here
+  held.clear();
+  for (std::size_t k = 0; k < count; ++k) {
+    if (inside[k]) {
+      // Gives back the blocks of make_shared objects right away
+      nodes_[candidates_[k]].object.reset();
+    }
+  }
+  return freed;
+}
+
+template <typename Policy>
+void cycleCollector<Policy>::compact(std::size_t budget) {
+  for (; cursor_ < nodes_.size() && budget != 0; --budget) {
+    node &current = nodes_[cursor_];
+    if (!current.object.expired()) {
+      ++cursor_;
+      continue;
+    }
+    // The last node takes the place of the dead one, nothing else moves
+    index_.erase(current.address);
+    if (cursor_ + 1 != nodes_.size()) {
+      current = std::move(nodes_.back());
+      index_[current.address] = cursor_;
+    }
+    nodes_.pop_back();
+  }
+  if (cursor_ == nodes_.size()) {
+    phase_ = phase::idle;
+  }
+}
+
+} // namespace eds
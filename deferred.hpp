@@ -0,0 +1,294 @@
+#pragma once
+#include <atomic>  // For std::atomic
+#include <chrono>  // For std::chrono::microseconds
+#include <cstddef> // For std::size_t
+#include <cstdint> // For std::intptr_t
+#include <memory>  // For std::unique_ptr
+#include <mutex>   // For std::mutex, std::lock_guard
+#include <thread>  // For std::thread, std::this_thread::yield
+#include <vector>  // For the spilled objects
+
+namespace eds {
+
+/****************************************************************************
+*Deferred destruction: instead of running the destructor where the last     *
+*owner lets go, deferredDelete hands the object to a reclaimQueue and       *
+*returns right away. The destructors run later in batches, on whatever      *
+*thread calls drain(): a backgroundReclaimer or the application itself when *
+*it is idle. That keeps the teardown of big object graphs off latency       *
+*critical threads.                                                          *
+*The queue is a bounded lock-free ring (Vyukov's MPMC queue), so its memory *
+*is fixed when it is created. What happens when it is full is up to the     *
+*queue:                                                                     *
+*  overflow::destroy_inline the object is destroyed right there, like with  *
+*                           a plain delete (the default)                    *
+*  overflow::wait           the retiring thread yields until a drain makes  *
+*                           room (needs some other thread draining)         *
+*  overflow::spill          the object goes to an unbounded side list under *
+*                           a mutex, drained after the ring. Memory is no   *
+*                           longer bounded, for producers that must never   *
+*                           block or destroy                                *
+*Destructors run by drain() may retire more objects into the same queue. A  *
+*full queue never makes those wait: under overflow::wait they are spilled,  *
+*since the only thread that could make room is the one retiring.            *
+****************************************************************************/
+class reclaimQueue {
+public:
+  // What retire does when the queue is full
+  enum class overflow { destroy_inline, wait, spill };
+
+  // Capacity is rounded up to a power of two
+  explicit reclaimQueue(std::size_t capacity = 4096,
+                        overflow whenFull = overflow::destroy_inline);
+  reclaimQueue(const reclaimQueue &) = delete;
+  reclaimQueue &operator=(const reclaimQueue &) = delete;
+  // Destroys whatever is still queued
+  ~reclaimQueue() { drain(); }
+
+  // Queues object for destruction with delete
+  template <typename T> void retire(T *object) {
+    retire(object, [](void *ptr) noexcept { delete static_cast<T *>(ptr); });
+  }
+  // Queues object for destruction through destroy
+  void retire(void *object, void (*destroy)(void *) noexcept);
+  // Same, but gives up instead of applying the overflow policy
+  bool try_retire(void *object, void (*destroy)(void *) noexcept) noexcept;
+  // Destroys up to limit queued objects, returns how many it destroyed
+  std::size_t drain(std::size_t limit = std::size_t(-1)) noexcept;
+  // Number of queued objects (spilled ones included), only a snapshot while
+  // other threads are active
+  std::size_t size() const noexcept;
+  std::size_t capacity() const noexcept { return mask_ + 1; }
+  // Queue used by default constructed deferredDeletes, drained at exit
+  static reclaimQueue &default_queue();
+
+private:
+  struct cell {
+    std::atomic<std::size_t> sequence;
+    void *object;
+    void (*destroy)(void *) noexcept;
+  };
+
+  struct retired {
+    void *object;
+    void (*destroy)(void *) noexcept;
+  };
+
+  // Puts object on the side list, destroys it if that cannot grow
+  void spill(void *object, void (*destroy)(void *) noexcept) noexcept;
+  // Destroys up to limit spilled objects, returns how many
+  std::size_t drain_spilled(std::size_t limit) noexcept;
+
+  std::size_t mask_;
+  overflow whenFull_;
+  std::unique_ptr<cell[]> cells_;
+  // Objects that did not fit into the ring
+  std::mutex spillMutex_;
+  std::vector<retired> spilled_;
+  std::atomic<std::size_t> spilledCount_{0};
+  // Queue the calling thread is draining, if any
+  static inline thread_local const reclaimQueue *draining_ = nullptr;
+  // Producers and consumers work on different cache lines
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  alignas(64) std::atomic<std::size_t> head_{0};
+};
+
+inline reclaimQueue::reclaimQueue(std::size_t capacity, overflow whenFull)
+    : mask_(1), whenFull_(whenFull) {
+  while (mask_ + 1 < capacity) {
+    mask_ = (mask_ << 1) | 1;
+  }
+  cells_.reset(new cell[mask_ + 1]);
+  for (std::size_t i = 0; i <= mask_; ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+inline void reclaimQueue::retire(void *object, void (*destroy)(void *) noexcept) {
+  while (!try_retire(object, destroy)) {
+    if (whenFull_ == overflow::destroy_inline) {
+      destroy(object);
+      return;
+    }
+    if (whenFull_ == overflow::spill || draining_ == this) {
+      // Waiting inside a drain of this queue would wait on ourselves
+      spill(object, destroy);
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+inline void reclaimQueue::spill(void *object,
+                                void (*destroy)(void *) noexcept) noexcept {
+  try {
+    std::lock_guard<std::mutex> lock(spillMutex_);
+    spilled_.push_back({object, destroy});
+    spilledCount_.fetch_add(1, std::memory_order_relaxed);
+  } catch (...) {
+    // No memory to defer it, so it is not deferred
+    destroy(object);
+  }
+}
+
+inline std::size_t reclaimQueue::drain_spilled(std::size_t limit) noexcept {
+  if (spilledCount_.load(std::memory_order_relaxed) == 0) {
+    return 0;
+  }
+  std::vector<retired> batch;
+  {
+    std::lock_guard<std::mutex> lock(spillMutex_);
+    if (limit >= spilled_.size()) {
+      batch.swap(spilled_);
+    } else {
+      try {
+        batch.assign(spilled_.end() - static_cast<std::ptrdiff_t>(limit),
+                     spilled_.end());
+      } catch (...) {
+        return 0;
+      }
+      spilled_.resize(spilled_.size() - limit);
+    }
+    spilledCount_.fetch_sub(batch.size(), std::memory_order_relaxed);
+  }
+  // Run outside the lock, they may spill again
+  for (const retired &each : batch) {
+    each.destroy(each.object);
+  }
+  return batch.size();
+}
+
+inline bool reclaimQueue::try_retire(void *object,
+                                     void (*destroy)(void *) noexcept) noexcept {
+  std::size_t position = tail_.load(std::memory_order_relaxed);
+  cell *slot;
+  for (;;) {
+    slot = &cells_[position & mask_];
+    std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    std::intptr_t difference =
+        static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+    if (difference == 0) {
+      // The cell is free for this lap, claim it
+      if (tail_.compare_exchange_weak(position, position + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (difference < 0) {
+      // Still holds an object from the previous lap, the queue is full
+      return false;
+    } else {
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+  slot->object = object;
+  slot->destroy = destroy;
+  slot->sequence.store(position + 1, std::memory_order_release);
+  return true;
+}
+
+inline std::size_t reclaimQueue::drain(std::size_t limit) noexcept {
+  const reclaimQueue *outer = draining_;
+  draining_ = this;
+  std::size_t destroyed = 0;
+  while (destroyed < limit) {
+    std::size_t position = head_.load(std::memory_order_relaxed);
+    cell *slot;
+    for (;;) {
+      slot = &cells_[position & mask_];
+      std::size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      std::intptr_t difference = static_cast<std::intptr_t>(sequence) -
+                                 static_cast<std::intptr_t>(position + 1);
+      if (difference == 0) {
+        if (head_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // Nothing published in this cell yet, the ring is empty
+        slot = nullptr;
+        break;
+      } else {
+        position = head_.load(std::memory_order_relaxed);
+      }
+    }
+    if (slot == nullptr) {
+      std::size_t spilled = drain_spilled(limit - destroyed);
+      if (spilled == 0) {
+        break;
+      }
+      destroyed += spilled;
+      continue;
+    }
+    void *object = slot->object;
+    void (*destroy)(void *) noexcept = slot->destroy;
+    // Hands the cell back to the producers for the next lap
+    slot->sequence.store(position + mask_ + 1, std::memory_order_release);
+    destroy(object);
+    ++destroyed;
+  }
+  draining_ = outer;
+  return destroyed;
+}
+
+inline std::size_t reclaimQueue::size() const noexcept {
+  std::size_t tail = tail_.load(std::memory_order_relaxed);
+  std::size_t head = head_.load(std::memory_order_relaxed);
+  return (tail > head ? tail - head : 0) +
+         spilledCount_.load(std::memory_order_relaxed);
+}
+
+inline reclaimQueue &reclaimQueue::default_queue() {
+  static reclaimQueue queue;
+  return queue;
+}
+
+// Deleter handing the object to a reclaimQueue instead of deleting it, works
+// with uniquePointer<T, deferredDelete<T>> and sharedPointer(ptr, deleter)
+template <typename T> class deferredDelete {
+public:
+  deferredDelete() noexcept : queue_(&reclaimQueue::default_queue()) {}
+  explicit deferredDelete(reclaimQueue &queue) noexcept : queue_(&queue) {}
+  void operator()(T *ptr) const { queue_->retire(ptr); }
+
+private:
+  reclaimQueue *queue_;
+};
+
+// Thread draining a reclaimQueue in batches, sleeping while it is empty.
+// Stops and drains what is left when destroyed
+class backgroundReclaimer {
+public:
+  explicit backgroundReclaimer(
+      reclaimQueue &queue = reclaimQueue::default_queue(),
+      std::chrono::microseconds idle = std::chrono::microseconds(1000),
+      std::size_t batch = 256);
+  backgroundReclaimer(const backgroundReclaimer &) = delete;
+  backgroundReclaimer &operator=(const backgroundReclaimer &) = delete;
+  ~backgroundReclaimer();
+
+private:
+  reclaimQueue &queue_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+inline backgroundReclaimer::backgroundReclaimer(reclaimQueue &queue,
+                                                std::chrono::microseconds idle,
+                                                std::size_t batch)
+    : queue_(queue) {
+  thread_ = std::thread([this, idle, batch] {
+    while (!stop_.load(std::memory_order_acquire)) {
+      if (queue_.drain(batch) == 0) {
+        std::this_thread::sleep_for(idle);
+      }
+    }
+  });
+}
+
+inline backgroundReclaimer::~backgroundReclaimer() {
+  stop_.store(true, std::memory_order_release);
+  thread_.join();
+  queue_.drain();
+}
+
+} // namespace eds
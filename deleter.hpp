@@ -0,0 +1,71 @@
+#pragma once
+#include <type_traits> // For std::is_empty, std::is_final, std::void_t
+#include <utility>     // For std::move
+
+namespace eds {
+
+// The handle a deleter works on, D::pointer if it names one (file
+// descriptors, device handles...), otherwise a plain T* (element pointer for
+// arrays)
+template <typename T, typename D, typename = void> struct deleterPointer {
+  using type = std::remove_extent_t<T> *;
+};
+template <typename T, typename D>
+struct deleterPointer<T, D, std::void_t<typename D::pointer>> {
+  using type = typename D::pointer;
+};
+
+// Default deleter, what uniquePointer and sharedPointer use unless told otherwise
+template <typename T> struct defaultDelete {
+  constexpr defaultDelete() noexcept = default;
+  // Allows a deleter for Derived to be converted into one for Base
+  template <typename U,
+            typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+  defaultDelete(const defaultDelete<U> &) noexcept {}
+  void operator()(T *ptr) const noexcept {
+    static_assert(sizeof(T) > 0, "can't delete a pointer to an incomplete type");
+    delete ptr;
+  }
+};
+
+// Default deleter for arrays, calls delete[]
+template <typename T> struct defaultDelete<T[]> {
+  constexpr defaultDelete() noexcept = default;
+  void operator()(T *ptr) const noexcept {
+    static_assert(sizeof(T) > 0, "can't delete a pointer to an incomplete type");
+    delete[] ptr;
+  }
+};
+
+/****************************************************************************
+*Stores a deleter (or an allocator) next to whatever the owner keeps. An    *
+*empty, non-final type is inherited from instead of being a member, so the  *
+*empty base optimization makes it cost no space at all: a uniquePointer     *
+*with a stateless deleter stays exactly one pointer wide and the call to    *
+*the deleter is inlined like a plain delete. Derive from it, a member would *
+*still take a byte. Index tells two storages of one class apart.           *
+****************************************************************************/
+template <typename D, int Index = 0,
+          bool Empty = std::is_empty<D>::value && !std::is_final<D>::value>
+class eboStorage : private D {
+public:
+  eboStorage() = default;
+  template <typename U>
+  explicit eboStorage(U &&value) : D(std::forward<U>(value)) {}
+  D &value() noexcept { return *this; }
+  const D &value() const noexcept { return *this; }
+};
+
+template <typename D, int Index> class eboStorage<D, Index, false> {
+public:
+  eboStorage() = default;
+  template <typename U>
+  explicit eboStorage(U &&value) : value_(std::forward<U>(value)) {}
+  D &value() noexcept { return value_; }
+  const D &value() const noexcept { return value_; }
+
+private:
+  D value_;
+};
+
+} // namespace eds
@@ -0,0 +1,257 @@
+#pragma once
+#include "shared.hpp"
+#include "unique.hpp"
+#include <atomic>  // For std::atomic, std::atomic_thread_fence
+#include <cstddef> // For std::size_t
+#include <cstdint> // For std::uint64_t
+#include <mutex>   // For std::mutex, std::lock_guard
+#include <thread>  // For std::this_thread::yield
+#include <utility> // For std::move
+#include <vector>  // For the records
+
+namespace eds {
+
+/****************************************************************************
+*Epoch-based reclamation for read-mostly structures. A reader opens an      *
+*epochGuard and may then follow raw pointers (get() of a sharedPointer or   *
+*uniquePointer, or an std::atomic<T *> it publishes) without touching any   *
+*count. A writer unlinks an object and hands its owner to                   *
+*epochDomain::retire instead of dropping it. The owner is only destroyed    *
+*after every guard that was open at that moment has closed, so the object   *
+*goes away through its usual deleter, control block and all.                *
+*There is one global epoch. Entering a guard publishes the epoch the thread *
+*is in. The epoch moves on once every thread inside a guard has seen the    *
+*current one, and an object retired in epoch e is safe to destroy once the  *
+*global epoch reaches e + 2.                                                *
+*Each thread keeps its own list of retired owners and reclaims it every     *
+*collectInterval retires (or on collect()). Lists of exited threads are    *
+*adopted by the next thread that collects.                                  *
+****************************************************************************/
+class epochDomain {
+public:
+  // Retires this many owners between two automatic collections
+  static constexpr std::size_t collectInterval = 64;
+
+  // Marks the calling thread as reading, guards nest
+  static void enter() noexcept;
+  static void exit() noexcept;
+  // Destroys ptr with deleter once no reader can still see it
+  template <typename T, typename D = defaultDelete<T>>
+  static void retire(T *ptr, D deleter = D());
+  // Drops the owner once no reader can still see its object
+  template <typename T, typename D> static void retire(uniquePointer<T, D> owner);
+  template <typename T, typename Policy>
+  static void retire(sharedPointer<T, Policy> owner);
+  // Advances the epoch if possible and destroys what is past its grace
+  // period, returns how many owners it dropped
+  static std::size_t collect();
+  // Waits until everything the calling thread retired is dropped, must not be
+  // called inside a guard
+  static void synchronize();
+  // Owners the calling thread retired that are not dropped yet
+  static std::size_t pending() noexcept;
+
+private:
+  // A retired owner, reclaim destroys the node and with it the owner
+  struct retiredNode {
+    retiredNode *next = nullptr;
+    std::uint64_t epoch = 0;
+    void (*reclaim)(retiredNode *) noexcept = nullptr;
+  };
+  template <typename Owner> struct retiredOwner : retiredNode {
+    explicit retiredOwner(Owner &&value) : owner(std::move(value)) {}
+    Owner owner;
+  };
+  // Per-thread state, state_ is epoch << 1 | 1 while inside a guard, else 0
+  struct record {
+    std::atomic<std::uint64_t> state_{0};
+    unsigned depth_ = 0;
+    retiredNode *retired_ = nullptr;
+    std::size_t pending_ = 0;
+    std::size_t sinceCollect_ = 0;
+  };
+  // Everything shared between threads, never destroyed
+  struct registry {
+    std::mutex mutex;
+    std::vector<record *> records;
+    std::vector<record *> freeRecords;
+    // Retired lists of exited threads
+    retiredNode *orphans = nullptr;
+  };
+  // Hands the retired list over when the thread exits
+  struct exitGuard {
+    ~exitGuard();
+  };
+
+  static registry &shared_state();
+  // Record of the calling thread, registers the thread on first use
+  static record *current();
+  template <typename Owner> static void push(Owner &&owner);
+  // Moves the global epoch on if every reader has seen it
+  static void try_advance(record *self);
+
+  static inline std::atomic<std::uint64_t> epoch_{0};
+  static inline thread_local record *record_ = nullptr;
+};
+
+// Scoped read-side critical section of epochDomain
+class epochGuard {
+public:
+  epochGuard() noexcept { epochDomain::enter(); }
+  epochGuard(const epochGuard &) = delete;
+  epochGuard &operator=(const epochGuard &) = delete;
+  ~epochGuard() { epochDomain::exit(); }
+};
+
+inline void epochDomain::enter() noexcept {
+  record *self = current();
+  if (self->depth_++ == 0) {
+    self->state_.store(epoch_.load(std::memory_order_relaxed) << 1 | 1,
+                       std::memory_order_relaxed);
+    // The published epoch must be visible before any pointer is read
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+}
+
+inline void epochDomain::exit() noexcept {
+  record *self = record_;
+  if (--self->depth_ == 0) {
+    // Orders the reads of the critical section before leaving it
+    self->state_.store(0, std::memory_order_release);
+  }
+}
+
+template <typename T, typename D>
+void epochDomain::retire(T *ptr, D deleter) {
+  retire(uniquePointer<T, D>(ptr, std::move(deleter)));
+}
+
+template <typename T, typename D>
+void epochDomain::retire(uniquePointer<T, D> owner) {
+  push(std::move(owner));
+}
+
+template <typename T, typename Policy>
+void epochDomain::retire(sharedPointer<T, Policy> owner) {
+  push(std::move(owner));
+}
+
+template <typename Owner> void epochDomain::push(Owner &&owner) {
+  record *self = current();
+  retiredNode *node = new retiredOwner<Owner>(std::move(owner));
+  node->reclaim = [](retiredNode *dead) noexcept {
+    delete static_cast<retiredOwner<Owner> *>(dead);
+  };
+  node->epoch = epoch_.load(std::memory_order_acquire);
+  node->next = self->retired_;
+  self->retired_ = node;
+  ++self->pending_;
+  if (++self->sinceCollect_ >= collectInterval) {
+    collect();
+  }
+}
+
+inline epochDomain::registry &epochDomain::shared_state() {
+  // Never destroyed, threads may still exit while statics are torn down
+  static registry *state = new registry();
+  return *state;
+}
+
+inline epochDomain::record *epochDomain::current() {
+  if (record_ == nullptr) {
+    registry &state = shared_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.freeRecords.empty()) {
+      record_ = state.freeRecords.back();
+      state.freeRecords.pop_back();
+    } else {
+      record_ = new record();
+      state.records.push_back(record_);
+    }
+    // Constructed on first use, its destructor runs when the thread exits
+    static thread_local exitGuard guard;
+    (void)guard;
+  }
+  return record_;
+}
+
+inline epochDomain::exitGuard::~exitGuard() {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  record *self = record_;
+  while (self->retired_ != nullptr) {
+    retiredNode *node = self->retired_;
+    self->retired_ = node->next;
+    node->next = state.orphans;
+    state.orphans = node;
+  }
+  self->pending_ = 0;
+  self->sinceCollect_ = 0;
+  state.freeRecords.push_back(self);
+  record_ = nullptr;
+}
+
+inline void epochDomain::try_advance(record *self) {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  // Adopts the lists of exited threads
+  while (state.orphans != nullptr) {
+    retiredNode *node = state.orphans;
+    state.orphans = node->next;
+    node->next = self->retired_;
+    self->retired_ = node;
+    ++self->pending_;
+  }
+  std::uint64_t epoch = epoch_.load(std::memory_order_relaxed);
+  // Pairs with the fence in enter(), a reader not seen here reads after it
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  for (record *each : state.records) {
+    std::uint64_t reader = each->state_.load(std::memory_order_acquire);
+    if ((reader & 1) != 0 && (reader >> 1) != epoch) {
+      return;
+    }
+  }
+  epoch_.compare_exchange_strong(epoch, epoch + 1, std::memory_order_acq_rel);
+}
+
+inline std::size_t epochDomain::collect() {
+  record *self = current();
+  self->sinceCollect_ = 0;
+  try_advance(self);
+  std::uint64_t epoch = epoch_.load(std::memory_order_acquire);
+  std::size_t dropped = 0;
+  // Unlinks the expired nodes first, an owner's destructor may retire more
+  retiredNode *expired = nullptr;
+  for (retiredNode **link = &self->retired_; *link != nullptr;) {
+    retiredNode *node = *link;
+    if (node->epoch + 2 <= epoch) {
+      *link = node->next;
+      node->next = expired;
+      expired = node;
+      --self->pending_;
+      ++dropped;
+    } else {
+      link = &node->next;
+    }
+  }
+  while (expired != nullptr) {
+    retiredNode *node = expired;
+    expired = node->next;
+    node->reclaim(node);
+  }
+  return dropped;
+}
+
+inline void epochDomain::synchronize() {
+  collect();
+  while (pending() != 0) {
+    std::this_thread::yield();
+    collect();
+  }
+}
+
+inline std::size_t epochDomain::pending() noexcept {
+  return record_ == nullptr ? 0 : record_->pending_;
+}
+
+} // namespace eds
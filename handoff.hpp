@@ -0,0 +1,265 @@
+#pragma once
+#include "unique.hpp"
+#include <atomic>      // For std::atomic
+#include <cstddef>     // For std::size_t
+#include <cstdint>     // For std::intptr_t
+#include <memory>      // For std::unique_ptr
+#include <thread>      // For std::this_thread::yield
+#include <type_traits> // For std::is_empty
+#include <utility>     // For std::move
+
+namespace eds {
+
+/****************************************************************************
+*handoffQueue<T, D>: bounded lock-free MPMC ring for passing                *
+*uniquePointer<T, D> ownership between threads. A push release()s the       *
+*pointer into a cell and a pop wraps it into a new uniquePointer, so moving *
+*an item costs one CAS on each side and never copies or locks anything.     *
+*It is Vyukov's MPMC queue, like reclaimQueue in deferred.hpp, with the     *
+*payload cut down to one pointer:                                           *
+*  - consecutive positions are spread over different cache lines, so the    *
+*    threads working on neighbouring items do not share a line              *
+*  - head and tail sit on cache lines of their own                          *
+*  - try_push_batch and try_pop_batch claim a run of cells with one CAS     *
+*Only the pointer is stored, so D must be stateless: popped items get a     *
+*default constructed D. Empty items are refused, so an empty pop always     *
+*means an empty queue. Whatever is still queued is deleted with the queue.  *
+****************************************************************************/
+template <typename T, typename D = defaultDelete<T>> class handoffQueue {
+  static_assert(std::is_empty<D>::value,
+                "handoffQueue only stores the pointer, D must be stateless");
+
+public:
+  using item = uniquePointer<T, D>;
+  using pointer = typename item::pointer;
+
+  // Capacity is rounded up to a power of two of at least two cache lines
+  explicit handoffQueue(std::size_t capacity = 1024);
+  handoffQueue(const handoffQueue &) = delete;
+  handoffQueue &operator=(const handoffQueue &) = delete;
+  // Deletes whatever is still queued
+  ~handoffQueue();
+
+  // Takes over value, or leaves it alone and returns false if the queue is
+  // full. Empty items are never queued, for them it returns false as well
+  bool try_push(item &&value) noexcept;
+  // Takes over value, yielding until there is room. Does nothing if it is empty
+  void push(item &&value) noexcept;
+  // Oldest item, empty if the queue is empty
+  item try_pop() noexcept;
+  // Takes over a prefix of items[0, count) as far as there is room and up to
+  // the first empty item, the pushed ones are left empty. Returns how many
+  // were pushed
+  std::size_t try_push_batch(item *items, std::size_t count) noexcept;
+  // Moves up to count of the oldest items into out, returns how many
+  std::size_t try_pop_batch(item *out, std::size_t count) noexcept;
+  // Number of queued items, only a snapshot while other threads are active
+  std::size_t size() const noexcept;
+  bool empty() const noexcept { return size() == 0; }
+  std::size_t capacity() const noexcept { return mask_ + 1; }
+
+private:
+  struct cell {
+    std::atomic<std::size_t> sequence;
+    pointer value;
+  };
+  static constexpr std::size_t cacheLine = 64;
+  static constexpr std::size_t cellsPerLine =
+      sizeof(cell) < cacheLine ? cacheLine / sizeof(cell) : 1;
+  struct alignas(cacheLine) line {
+    cell cells[cellsPerLine];
+  };
+
+  // Cell of position: position i lands on line i % lines, so neighbours
+  // never share a line
+  cell &cell_at(std::size_t position) noexcept {
+    std::size_t index = position & mask_;
+    return lines_[index & lineMask_].cells[index >> lineShift_];
+  }
+  // Claims up to count cells for pushing, returns the first position
+  std::size_t claim_push(std::size_t &count) noexcept;
+  // Claims up to count published cells for popping, returns the first position
+  std::size_t claim_pop(std::size_t &count) noexcept;
+  void publish(std::size_t position, pointer value) noexcept;
+  pointer take(std::size_t position) noexcept;
+
+  std::size_t mask_;
+  std::size_t lineMask_;
+  unsigned lineShift_;
+  std::unique_ptr<line[]> lines_;
+  // Producers and consumers work on different cache lines
+  alignas(cacheLine) std::atomic<std::size_t> tail_{0};
+  alignas(cacheLine) std::atomic<std::size_t> head_{0};
+};
+
+template <typename T, typename D>
+handoffQueue<T, D>::handoffQueue(std::size_t capacity) : lineShift_(0) {
+  std::size_t lines = 2;
+  while (lines * cellsPerLine < capacity) {
+    lines <<= 1;
+  }
+  while ((std::size_t(1) << lineShift_) < lines) {
+    ++lineShift_;
+  }
+  lineMask_ = lines - 1;
+  mask_ = lines * cellsPerLine - 1;
+  lines_.reset(new line[lines]);
+  for (std::size_t i = 0; i <= mask_; ++i) {
+    cell_at(i).sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T, typename D> handoffQueue<T, D>::~handoffQueue() {
+  while (try_pop()) {
+  }
+}
+
+template <typename T, typename D>
+std::size_t handoffQueue<T, D>::claim_push(std::size_t &count) noexcept {
+  std::size_t position = tail_.load(std::memory_order_relaxed);
+  for (;;) {
+    // Free cells stay free until claimed, so checking before the CAS is safe
+    std::size_t free = 0;
+    while (free < count &&
+           cell_at(position + free).sequence.load(std::memory_order_acquire) ==
+               position + free) {
+      ++free;
+    }
+    if (free == 0) {
+      std::intptr_t difference =
+          static_cast<std::intptr_t>(
+              cell_at(position).sequence.load(std::memory_order_relaxed)) -
+          static_cast<std::intptr_t>(position);
+      if (difference < 0) {
+        // Still holds an item from the previous lap, the queue is full
+        count = 0;
+        return position;
+      }
+      // Another producer got there first
+      position = tail_.load(std::memory_order_relaxed);
+    } else if (tail_.compare_exchange_weak(position, position + free,
+                                           std::memory_order_relaxed)) {
+      count = free;
+      return position;
+    }
+  }
+}
+
+template <typename T, typename D>
+std::size_t handoffQueue<T, D>::claim_pop(std::size_t &count) noexcept {
+  std::size_t position = head_.load(std::memory_order_relaxed);
+  for (;;) {
+    // Published cells stay published until claimed
+    std::size_t ready = 0;
+    while (ready < count &&
+           cell_at(position + ready).sequence.load(std::memory_order_acquire) ==
+               position + ready + 1) {
+      ++ready;
+    }
+    if (ready == 0) {
+      std::intptr_t difference =
+          static_cast<std::intptr_t>(
+              cell_at(position).sequence.load(std::memory_order_relaxed)) -
+          static_cast<std::intptr_t>(position + 1);
+      if (difference < 0) {
+        // Nothing published in this cell yet, the queue is empty
+        count = 0;
+        return position;
+      }
+      // Another consumer got there first
+      position = head_.load(std::memory_order_relaxed);
+    } else if (head_.compare_exchange_weak(position, position + ready,
+                                           std::memory_order_relaxed)) {
+      count = ready;
+      return position;
+    }
+  }
+}
+
+template <typename T, typename D>
+void handoffQueue<T, D>::publish(std::size_t position, pointer value) noexcept {
+  cell &slot = cell_at(position);
+  slot.value = value;
+  slot.sequence.store(position + 1, std::memory_order_release);
+}
+
+template <typename T, typename D>
+typename handoffQueue<T, D>::pointer
+handoffQueue<T, D>::take(std::size_t position) noexcept {
+  cell &slot = cell_at(position);
+  pointer value = slot.value;
+  // Hands the cell back to the producers for the next lap
+  slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+  return value;
+}
+
+template <typename T, typename D>
+bool handoffQueue<T, D>::try_push(item &&value) noexcept {
+  if (!value) {
+    return false;
+  }
+  std::size_t count = 1;
+  std::size_t position = claim_push(count);
+  if (count == 0) {
+    return false;
+  }
+  publish(position, value.release());
+  return true;
+}
+
+template <typename T, typename D>
+void handoffQueue<T, D>::push(item &&value) noexcept {
+  if (!value) {
+    return;
+  }
+  while (!try_push(std::move(value))) {
+    std::this_thread::yield();
+  }
+}
+
+template <typename T, typename D>
+typename handoffQueue<T, D>::item handoffQueue<T, D>::try_pop() noexcept {
+  std::size_t count = 1;
+  std::size_t position = claim_pop(count);
+  if (count == 0) {
+    return item();
+  }
+  return item(take(position));
+}
+
+template <typename T, typename D>
+std::size_t handoffQueue<T, D>::try_push_batch(item *items,
+                                               std::size_t count) noexcept {
+  std::size_t filled = 0;
+  while (filled < count && items[filled]) {
+    ++filled;
+  }
+  if (filled == 0) {
+    return 0;
+  }
+  count = filled;
+  std::size_t position = claim_push(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    publish(position + i, items[i].release());
+  }
+  return count;
+}
+
+template <typename T, typename D>
+std::size_t handoffQueue<T, D>::try_pop_batch(item *out,
+                                              std::size_t count) noexcept {
+  std::size_t position = claim_pop(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    out[i].reset(take(position + i));
+  }
+  return count;
+}
+
+template <typename T, typename D>
+std::size_t handoffQueue<T, D>::size() const noexcept {
+  std::size_t tail = tail_.load(std::memory_order_relaxed);
+  std::size_t head = head_.load(std::memory_order_relaxed);
+  return tail > head ? tail - head : 0;
+}
+
+} // namespace eds
@@ -0,0 +1,276 @@
+#pragma once
+#include <cstddef>     // For std::size_t, std::nullptr_t, std::max_align_t
+#include <new>         // For std::launder, placement new
+#include <type_traits> // For std::is_base_of, std::is_nothrow_move_constructible
+#include <utility>     // For std::move, std::forward
+
+namespace eds {
+
+/****************************************************************************
+*inlineUniquePointer<Base, N> owns one object derived from Base like a      *
+*uniquePointer<Base>, but keeps it in an N-byte buffer inside the pointer   *
+*when it fits: no allocation, and the object sits on the same cache line as *
+*the handle. A Derived fits when it is at most N bytes, needs no more than  *
+*std::max_align_t alignment and moves without throwing, anything else goes  *
+*to the heap as usual.                                                      *
+*Next to the object pointer the handle keeps a pointer to a small table of  *
+*operations for the Derived it holds:                                       *
+*  relocate  move constructs the object into another buffer and destroys   *
+*            the old one (moves of inline objects), null for heap objects   *
+*  destroy   runs the destructor, and frees heap objects                    *
+*  to_heap   moves an inline object to the heap, for release()              *
+*so the object is always destroyed as the Derived it was made as, without   *
+*Base needing a virtual destructor (release() hands out a Base * that is    *
+*then deleted through Base, so it does need one there).                     *
+****************************************************************************/
+
+// Inline buffer size used unless told otherwise, three pointers
+constexpr std::size_t defaultInlineSize = 3 * sizeof(void *);
+
+template <typename Base, std::size_t N = defaultInlineSize>
+class inlineUniquePointer {
+public:
+  using element_type = Base;
+  using pointer = Base *;
+
+  // True if Derived goes into the inline buffer
+  template <typename Derived>
+  static constexpr bool fits_inline =
+      sizeof(Derived) <= N && alignof(Derived) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible<Derived>::value;
+
+  // Default constructor, owns nothing
+  inlineUniquePointer() noexcept;
+  // Constructor for nullptr
+  inlineUniquePointer(std::nullptr_t) noexcept;
+  // Adopts a heap object, deleted through Base
+  explicit inlineUniquePointer(Base *ptr) noexcept;
+  // Copy constructor deleted to enforce unique ownership
+  inlineUniquePointer(const inlineUniquePointer &other) = delete;
+  // Copy assignment operator deleted to enforce unique ownership
+  inlineUniquePointer &operator=(const inlineUniquePointer &other) = delete;
+  // Move constructor, relocates an inline object into this buffer
+  inlineUniquePointer(inlineUniquePointer &&other) noexcept;
+  // Move assignment operator
+  inlineUniquePointer &operator=(inlineUniquePointer &&other) noexcept;
+  // Destructor
+  ~inlineUniquePointer();
+  // Builds a Derived from args, inline if it fits, and returns it
+  template <typename Derived, typename... Args>
+  Derived &emplace(Args &&...args);
+  // Function to get the raw pointer
+  Base *get() const noexcept { return pointer_; }
+  // Dereference operator
+  Base &operator*() const noexcept { return *pointer_; }
+  // Member access operator
+  Base *operator->() const noexcept { return pointer_; }
+  // Explicit conversion operator to bool
+  explicit operator bool() const noexcept { return pointer_ != nullptr; }
+  // True if the object lives in the inline buffer
+  bool is_inline() const noexcept;
+  // Destroys the object and adopts ptr (a heap object deleted through Base)
+  void reset(Base *ptr = nullptr) noexcept;
+  // Gives up ownership, an inline object is moved to the heap first
+  Base *release();
+  // Swap function to exchange the contents with another inline pointer
+  void swap(inlineUniquePointer &other) noexcept;
+
+private:
+  struct operations {
+    Base *(*relocate)(void *from, void *to) noexcept;
+    void (*destroy)(Base *ptr) noexcept;
+    Base *(*to_heap)(Base *ptr);
+  };
+
+  template <typename Derived>
+  static Base *relocate_inline(void *from, void *to) noexcept;
+  template <typename Derived> static void destroy_inline(Base *ptr) noexcept;
+  template <typename Derived> static void destroy_heap(Base *ptr) noexcept;
+  template <typename Derived> static Base *move_to_heap(Base *ptr);
+
+  template <typename Derived>
+  static constexpr operations inlineOperations{&relocate_inline<Derived>,
+                                               &destroy_inline<Derived>,
+                                               &move_to_heap<Derived>};
+  template <typename Derived>
+  static constexpr operations heapOperations{nullptr, &destroy_heap<Derived>,
+                                             nullptr};
+
+  // Takes over other's object, leaves other empty, this must be empty
+  void take(inlineUniquePointer &other) noexcept;
+
+  alignas(std::max_align_t) unsigned char buffer_[N];
+  // The object, in buffer_ or on the heap
+  Base *pointer_;
+  // Operations for the Derived behind pointer_, null when empty
+  const operations *operations_;
+};
+
+// Default constructor
+template <typename Base, std::size_t N>
+inlineUniquePointer<Base, N>::inlineUniquePointer() noexcept
+    : pointer_(nullptr), operations_(nullptr) {}
+
+// Constructor for nullptr
+template <typename Base, std::size_t N>
+inlineUniquePointer<Base, N>::inlineUniquePointer(std::nullptr_t) noexcept
+    : pointer_(nullptr), operations_(nullptr) {}
+
+// Adopting constructor
+template <typename Base, std::size_t N>
+inlineUniquePointer<Base, N>::inlineUniquePointer(Base *ptr) noexcept
+    : pointer_(ptr),
+      operations_(ptr != nullptr ? &heapOperations<Base> : nullptr) {}
+
+// Move constructor
+template <typename Base, std::size_t N>
+inlineUniquePointer<Base, N>::inlineUniquePointer(
+    inlineUniquePointer &&other) noexcept
+    : pointer_(nullptr), operations_(nullptr) {
+  take(other);
+}
+
+// Move assignment operator
+template <typename Base, std::size_t N>
+inlineUniquePointer<Base, N> &
+inlineUniquePointer<Base, N>::operator=(inlineUniquePointer &&other) noexcept {
+  if (this != &other) {
+    reset();
+    take(other);
+  }
+  return *this;
+}
+
+// Destructor
+template <typename Base, std::size_t N>
+inlineUniquePointer<Base, N>::~inlineUniquePointer() {
+  reset();
+}
+
+// Builds the object in place
+template <typename Base, std::size_t N>
+template <typename Derived, typename... Args>
+Derived &inlineUniquePointer<Base, N>::emplace(Args &&...args) {
+  static_assert(std::is_base_of<Base, Derived>::value,
+                "inlineUniquePointer<Base> holds objects derived from Base");
+  reset();
+  Derived *object;
+  if constexpr (fits_inline<Derived>) {
+    object = ::new (static_cast<void *>(buffer_))
+        Derived(std::forward<Args>(args)...);
+    operations_ = &inlineOperations<Derived>;
+  } else {
+    object = new Derived(std::forward<Args>(args)...);
+    operations_ = &heapOperations<Derived>;
+  }
+  pointer_ = object;
+  return *object;
+}
+
+// True if the object lives in the inline buffer
+template <typename Base, std::size_t N>
+bool inlineUniquePointer<Base, N>::is_inline() const noexcept {
+  return operations_ != nullptr && operations_->relocate != nullptr;
+}
+
+// Destroys the object and adopts ptr
+template <typename Base, std::size_t N>
+void inlineUniquePointer<Base, N>::reset(Base *ptr) noexcept {
+  if (pointer_ != nullptr) {
+    Base *old = pointer_;
+    const operations *oldOperations = operations_;
+    pointer_ = nullptr;
+    operations_ = nullptr;
+    oldOperations->destroy(old);
+  }
+  if (ptr != nullptr) {
+    pointer_ = ptr;
+    operations_ = &heapOperations<Base>;
+  }
+}
+
+// Gives up ownership
+template <typename Base, std::size_t N>
+Base *inlineUniquePointer<Base, N>::release() {
+  Base *released = pointer_;
+  if (is_inline()) {
+    // May throw, the object then stays where it is
+    released = operations_->to_heap(pointer_);
+  }
+  pointer_ = nullptr;
+  operations_ = nullptr;
+  return released;
+}
+
+// Swap function, through a third pointer since inline objects have to move
+template <typename Base, std::size_t N>
+void inlineUniquePointer<Base, N>::swap(inlineUniquePointer &other) noexcept {
+  inlineUniquePointer temporary(std::move(other));
+  other.take(*this);
+  take(temporary);
+}
+
+// Takes over other's object
+template <typename Base, std::size_t N>
+void inlineUniquePointer<Base, N>::take(inlineUniquePointer &other) noexcept {
+  if (other.pointer_ == nullptr) {
+    return;
+  }
+  operations_ = other.operations_;
+  if (operations_->relocate != nullptr) {
+    pointer_ = operations_->relocate(other.buffer_, buffer_);
+  } else {
+    pointer_ = other.pointer_;
+  }
+  other.pointer_ = nullptr;
+  other.operations_ = nullptr;
+}
+
+template <typename Base, std::size_t N>
+template <typename Derived>
+Base *inlineUniquePointer<Base, N>::relocate_inline(void *from,
+                                                    void *to) noexcept {
+  Derived *source = std::launder(static_cast<Derived *>(from));
+  Derived *target = ::new (to) Derived(std::move(*source));
+  source->~Derived();
+  return target;
+}
+
+template <typename Base, std::size_t N>
+template <typename Derived>
+void inlineUniquePointer<Base, N>::destroy_inline(Base *ptr) noexcept {
+  static_cast<Derived *>(ptr)->~Derived();
+}
+
+template <typename Base, std::size_t N>
+template <typename Derived>
+void inlineUniquePointer<Base, N>::destroy_heap(Base *ptr) noexcept {
+  delete static_cast<Derived *>(ptr);
+}
+
+template <typename Base, std::size_t N>
+template <typename Derived>
+Base *inlineUniquePointer<Base, N>::move_to_heap(Base *ptr) {
+  Derived *source = static_cast<Derived *>(ptr);
+  Derived *moved = new Derived(std::move(*source));
+  source->~Derived();
+  return moved;
+}
+
+// Free function swap that calls upon the swap method of inlineUniquePointer
+template <typename Base, std::size_t N>
+void swap(inlineUniquePointer<Base, N> &one,
+          inlineUniquePointer<Base, N> &other) noexcept {
+  one.swap(other);
+}
+
+// Make function, a Derived owned through Base, inline if it fits in N bytes
+template <typename Base, typename Derived, std::size_t N = defaultInlineSize,
+          typename... Args>
+inlineUniquePointer<Base, N> make_inline_unique(Args &&...args) {
+  inlineUniquePointer<Base, N> result;
+  result.template emplace<Derived>(std::forward<Args>(args)...);
+  return result;
+}
+
+} // namespace eds
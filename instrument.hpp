@@ -0,0 +1,212 @@
+#pragma once
+
+/****************************************************************************
+*Optional instrumentation of sharedPointer. Define EDS_INSTRUMENTATION       *
+*before including any eds header (or pass -DEDS_INSTRUMENTATION) to count,  *
+*per pointee type T:                                                         *
+*  constructions      new owners of an object (make_shared, sharedPointer(p))*
+*  copies, moves      copy and move construction/assignment of non-empty    *
+*                     sharedPointers                                        *
+*  destructions       non-empty sharedPointers going away                   *
+*  lock successes and failures (sharedPointer from weakPointer, lock())     *
+*  block allocations  control blocks allocated                              *
+*Every thread counts into its own record with plain (relaxed, non-locked)   *
+*stores, so the counters cost about as much as an increment.                *
+*instrumentation::snapshot() adds all threads up, instrumentation::reset()  *
+*makes the next snapshot start from zero again.                             *
+*Without the macro EDS_COUNT expands to nothing and none of this exists.    *
+****************************************************************************/
+
+#ifdef EDS_INSTRUMENTATION
+
+#include <atomic>   // For std::atomic
+#include <cstddef>  // For std::size_t
+#include <cstdint>  // For std::uint64_t
+#include <mutex>    // For std::mutex, std::lock_guard
+#include <typeinfo> // For typeid
+#include <vector>   // For the records and the snapshot
+
+namespace eds {
+
+// What happened to a sharedPointer of some T
+enum class pointerEvent {
+  construction,
+  copy,
+  move,
+  destruction,
+  lock_success,
+  lock_failure,
+  block_allocation
+};
+
+// Counts for one pointee type
+struct pointerCounters {
+  std::uint64_t constructions = 0;
+  std::uint64_t copies = 0;
+  std::uint64_t moves = 0;
+  std::uint64_t destructions = 0;
+  std::uint64_t lock_successes = 0;
+  std::uint64_t lock_failures = 0;
+  std::uint64_t block_allocations = 0;
+};
+
+// One line of a snapshot, type is the (implementation specific) typeid name
+struct typeCounters {
+  const char *type;
+  pointerCounters counters;
+};
+
+class instrumentation {
+public:
+  // Counts event for sharedPointer<T> on the calling thread
+  template <typename T> static void count(pointerEvent event) noexcept;
+  // Totals of all threads since the last reset, one entry per type seen
+  static std::vector<typeCounters> snapshot();
+  // Makes the next snapshot count from now on
+  static void reset();
+
+private:
+  // Types beyond this share the last slot, reported as "(other)"
+  static constexpr std::size_t maxTypes = 256;
+  static constexpr std::size_t eventCount = 7;
+
+  // Per-thread counters, only ever written by their thread
+  struct record {
+    std::atomic<std::uint64_t> counts[maxTypes][eventCount] = {};
+  };
+  // Everything shared between threads, never destroyed
+  struct registry {
+    std::mutex mutex;
+    std::vector<record *> records;
+    std::vector<record *> freeRecords;
+    const char *names[maxTypes] = {};
+    std::size_t types = 0;
+    std::uint64_t baseline[maxTypes][eventCount] = {};
+  };
+  // Unregisters the thread when it exits, its record keeps its counts
+  struct exitGuard {
+    ~exitGuard();
+  };
+
+  static registry &shared_state();
+  // Slot of T, registered on first use
+  template <typename T> static std::size_t type_index();
+  static std::size_t register_type(const char *name);
+  // Record of the calling thread, registers the thread on first use
+  static record *current();
+  // Sum over all records, to be called with the registry mutex held
+  static void totals(registry &state, std::uint64_t (&sum)[maxTypes][eventCount]);
+
+  static inline thread_local record *record_ = nullptr;
+};
+
+template <typename T>
+void instrumentation::count(pointerEvent event) noexcept {
+  std::atomic<std::uint64_t> &counter =
+      current()->counts[type_index<T>()][static_cast<std::size_t>(event)];
+  // Only this thread writes the counter, no read-modify-write needed
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+template <typename T> std::size_t instrumentation::type_index() {
+  static const std::size_t index = register_type(typeid(T).name());
+  return index;
+}
+
+inline std::size_t instrumentation::register_type(const char *name) {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (state.types == maxTypes - 1) {
+    state.names[maxTypes - 1] = "(other)";
+    return maxTypes - 1;
+  }
+  state.names[state.types] = name;
+  return state.types++;
+}
+
+inline instrumentation::registry &instrumentation::shared_state() {
+  // Never destroyed, threads may still exit while statics are torn down
+  static registry *state = new registry();
+  return *state;
+}
+
+inline instrumentation::record *instrumentation::current() {
+  if (record_ == nullptr) {
+    registry &state = shared_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.freeRecords.empty()) {
+      record_ = state.freeRecords.back();
+      state.freeRecords.pop_back();
+    } else {
+      record_ = new record();
+      state.records.push_back(record_);
+    }
+    // Constructed on first use, its destructor runs when the thread exits
+    static thread_local exitGuard guard;
+    (void)guard;
+  }
+  return record_;
+}
+
+inline instrumentation::exitGuard::~exitGuard() {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.freeRecords.push_back(record_);
+  record_ = nullptr;
+}
+
+inline void instrumentation::totals(registry &state,
+                                    std::uint64_t (&sum)[maxTypes][eventCount]) {
+  for (std::size_t type = 0; type < maxTypes; ++type) {
+    for (std::size_t event = 0; event < eventCount; ++event) {
+      sum[type][event] = 0;
+    }
+  }
+  for (record *each : state.records) {
+    for (std::size_t type = 0; type < maxTypes; ++type) {
+      for (std::size_t event = 0; event < eventCount; ++event) {
+        sum[type][event] +=
+            each->counts[type][event].load(std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+inline std::vector<typeCounters> instrumentation::snapshot() {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  static std::uint64_t sum[maxTypes][eventCount];
+  totals(state, sum);
+  std::vector<typeCounters> result;
+  for (std::size_t type = 0; type < maxTypes; ++type) {
+    if (state.names[type] == nullptr) {
+      continue;
+    }
+    std::uint64_t value[eventCount];
+    for (std::size_t event = 0; event < eventCount; ++event) {
+      value[event] = sum[type][event] - state.baseline[type][event];
+    }
+    result.push_back({state.names[type],
+                      {value[0], value[1], value[2], value[3], value[4],
+                       value[5], value[6]}});
+  }
+  return result;
+}
+
+inline void instrumentation::reset() {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  totals(state, state.baseline);
+}
+
+} // namespace eds
+
+#define EDS_COUNT(T, event)                                                    \
+  ::eds::instrumentation::count<T>(::eds::pointerEvent::event)
+
+#else
+
+#define EDS_COUNT(T, event) ((void)0)
+
+#endif
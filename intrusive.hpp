@@ -0,0 +1,262 @@
+#pragma once
+#include "policy.hpp"
+#include "shared.hpp"
+#include <atomic>  // For std::atomic
+#include <cstddef> // For std::size_t, std::nullptr_t
+#include <utility> // For std::move, std::forward
+
+namespace eds {
+
+/****************************************************************************
+*intrusivePointer is for types that carry their own reference count. It is  *
+*a single pointer wide and has no control block, so a copy touches only the *
+*object itself. Counting goes through two free functions found by ADL:      *
+*  add_ref(ptr)  -> one more reference                                      *
+*  release(ptr)  -> one reference less, destroys the object on the last one *
+*A type can provide them itself, or derive from refCounted<Derived, Policy>, *
+*which defines them with a plain (nonAtomicCount) or atomic (atomicCount)   *
+*counter that starts at zero.                                               *
+****************************************************************************/
+
+// Counter stored inside a refCounted object, picked by the counting Policy
+template <typename Policy> class refCount {
+  static_assert(sizeof(Policy) == 0,
+                "refCounted supports nonAtomicCount and atomicCount");
+};
+
+template <> class refCount<nonAtomicCount> {
+public:
+  void increment() noexcept { ++count_; }
+  // True when the last reference is gone
+  bool decrement() noexcept { return --count_ == 0; }
+  std::size_t count() const noexcept { return count_; }
+
+private:
+  std::size_t count_ = 0;
+};
+
+template <> class refCount<atomicCount> {
+public:
+  // A new reference is always made from an existing one, nothing to order
+  void increment() noexcept { count_.fetch_add(1, std::memory_order_relaxed); }
+  // Same ordering as atomicCount::decrement_shared
+  bool decrement() noexcept {
+    return count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+  std::size_t count() const noexcept {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::size_t> count_{0};
+};
+
+// Base class adding an embedded reference count to Derived
+template <typename Derived, typename Policy = nonAtomicCount> class refCounted {
+public:
+  // Number of intrusivePointers (and other add_ref holders) on this object
+  std::size_t use_count() const noexcept { return count_.count(); }
+
+protected:
+  refCounted() noexcept = default;
+  // A copy is a new object, it starts without references of its own
+  refCounted(const refCounted &) noexcept {}
+  refCounted &operator=(const refCounted &) noexcept { return *this; }
+  ~refCounted() = default;
+
+private:
+  friend void add_ref(const refCounted *ptr) noexcept {
+    ptr->count_.increment();
+  }
+  friend void release(const refCounted *ptr) noexcept {
+    if (ptr->count_.decrement()) {
+      delete static_cast<const Derived *>(ptr);
+    }
+  }
+
+  mutable refCount<Policy> count_;
+};
+
+// Calls the ADL hooks from outside the classes, where a member named release
+// would hide them
+template <typename T> void intrusive_add_ref(T *ptr) noexcept { add_ref(ptr); }
+template <typename T> void intrusive_release(T *ptr) noexcept { release(ptr); }
+
+// Intrusive Pointer class template, one pointer wide
+template <typename T> class intrusivePointer {
+public:
+  // Default constructor, owns nothing
+  intrusivePointer() noexcept;
+  // Constructor for nullptr
+  intrusivePointer(std::nullptr_t) noexcept;
+  // Constructor taking a raw pointer, addRef false adopts a reference the
+  // caller already holds
+  explicit intrusivePointer(T *ptr, bool addRef = true) noexcept;
+  // Copy constructor
+  intrusivePointer(const intrusivePointer &other) noexcept;
+  // Copy constructor from intrusivePointer of a different type
+  template <typename U>
+  intrusivePointer(const intrusivePointer<U> &other) noexcept;
+  // Copy assignment operator
+  intrusivePointer &operator=(const intrusivePointer &other) noexcept;
+  // Move constructor
+  intrusivePointer(intrusivePointer &&other) noexcept;
+  // Move assignment operator
+  intrusivePointer &operator=(intrusivePointer &&other) noexcept;
+  // Destructor
+  ~intrusivePointer();
+  // Function to get the raw pointer
+  T *get() const noexcept;
+  // Dereference operator
+  T &operator*() const noexcept;
+  // Member access operator
+  T *operator->() const noexcept;
+  // Explicit conversion operator to bool
+  explicit operator bool() const noexcept;
+  // Function to reset the intrusive pointer with a new raw pointer
+  void reset(T *ptr = nullptr) noexcept;
+  // Gives up ownership without dropping the reference and returns the pointer
+  T *detach() noexcept;
+  // Swap function to exchange the contents with another intrusive pointer
+  void swap(intrusivePointer &other) noexcept;
+
+private:
+  // Raw pointer to the owned resource, it counts its own references
+  T *pointer_;
+};
+
+// Default constructor
+template <typename T>
+intrusivePointer<T>::intrusivePointer() noexcept : pointer_(nullptr) {}
+
+// Constructor for nullptr
+template <typename T>
+intrusivePointer<T>::intrusivePointer(std::nullptr_t) noexcept
+    : pointer_(nullptr) {}
+
+// Constructor taking a raw pointer
+template <typename T>
+intrusivePointer<T>::intrusivePointer(T *ptr, bool addRef) noexcept
+    : pointer_(ptr) {
+  if (pointer_ != nullptr && addRef) {
+    intrusive_add_ref(pointer_);
+  }
+}
+
+// Copy constructor
+template <typename T>
+intrusivePointer<T>::intrusivePointer(const intrusivePointer &other) noexcept
+    : intrusivePointer(other.pointer_) {}
+
+// Copy constructor from intrusivePointer of a different type
+template <typename T>
+template <typename U>
+intrusivePointer<T>::intrusivePointer(const intrusivePointer<U> &other) noexcept
+    : intrusivePointer(other.get()) {}
+
+// Copy assignment operator using copy-and-swap
+template <typename T>
+intrusivePointer<T> &
+intrusivePointer<T>::operator=(const intrusivePointer &other) noexcept {
+  intrusivePointer(other).swap(*this);
+  return *this;
+}
+
+// Move constructor
+template <typename T>
+intrusivePointer<T>::intrusivePointer(intrusivePointer &&other) noexcept
+    : pointer_(other.pointer_) {
+  other.pointer_ = nullptr;
+}
+
+// Move assignment operator
+template <typename T>
+intrusivePointer<T> &
+intrusivePointer<T>::operator=(intrusivePointer &&other) noexcept {
+  intrusivePointer(std::move(other)).swap(*this);
+  return *this;
+}
+
+// Destructor
+template <typename T> intrusivePointer<T>::~intrusivePointer() {
+  if (pointer_ != nullptr) {
+    intrusive_release(pointer_);
+  }
+}
+
+// Function to get the raw pointer
+template <typename T> T *intrusivePointer<T>::get() const noexcept {
+  return pointer_;
+}
+
+// Dereference operator
+template <typename T> T &intrusivePointer<T>::operator*() const noexcept {
+  return *pointer_;
+}
+
+// Member access operator
+template <typename T> T *intrusivePointer<T>::operator->() const noexcept {
+  return pointer_;
+}
+
+// Explicit conversion operator to bool
+template <typename T>
+intrusivePointer<T>::operator bool() const noexcept {
+  return pointer_ != nullptr;
+}
+
+// Function to reset the intrusive pointer with a new raw pointer
+template <typename T> void intrusivePointer<T>::reset(T *ptr) noexcept {
+  intrusivePointer(ptr).swap(*this);
+}
+
+// Gives up ownership, the caller now holds the reference
+template <typename T> T *intrusivePointer<T>::detach() noexcept {
+  T *detached = pointer_;
+  pointer_ = nullptr;
+  return detached;
+}
+
+// Swap function to exchange the contents with another intrusive pointer
+template <typename T>
+void intrusivePointer<T>::swap(intrusivePointer &other) noexcept {
+  std::swap(pointer_, other.pointer_);
+}
+
+// Free function swap that calls upon the swap method of intrusivePointer
+template <typename T>
+void swap(intrusivePointer<T> &one, intrusivePointer<T> &other) noexcept {
+  one.swap(other);
+}
+
+// Make intrusive function, allocates the object and takes the first reference
+template <typename T, typename... Args>
+intrusivePointer<T> make_intrusive(Args &&...args) {
+  return intrusivePointer<T>(new T(std::forward<Args>(args)...));
+}
+
+// Deleter of a sharedPointer holding one intrusive reference
+template <typename T> struct intrusiveRelease {
+  void operator()(T *ptr) const noexcept { intrusive_release(ptr); }
+};
+
+// Hands an intrusive reference to a sharedPointer. Always safe, the object
+// lives on until both the sharedPointer and all other references are gone
+template <typename Policy = nonAtomicCount, typename T>
+sharedPointer<T, Policy> to_shared(intrusivePointer<T> ptr) {
+  // The deleter drops the detached reference, even if the constructor throws
+  return sharedPointer<T, Policy>(ptr.detach(), intrusiveRelease<T>());
+}
+
+// Takes a new intrusive reference on the object of a sharedPointer made by
+// to_shared. Any other sharedPointer deletes its object without looking at
+// the embedded count, so for those the result is empty
+template <typename T, typename Policy>
+intrusivePointer<T> from_shared(const sharedPointer<T, Policy> &ptr) {
+  if (get_deleter<intrusiveRelease<T>>(ptr) == nullptr) {
+    return intrusivePointer<T>();
+  }
+  return intrusivePointer<T>(ptr.get());
+}
+
+} // namespace eds
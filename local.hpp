@@ -0,0 +1,403 @@
+#pragma once
+#include "shared.hpp"
+#include <cassert> // For assert
+#include <cstddef>  // For std::size_t, std::nullptr_t
+#include <cstdint>  // For std::uint32_t
+#include <limits>   // For std::numeric_limits
+#include <memory>   // For std::allocator_traits
+#include <new>      // For placement new
+#include <utility>  // For std::forward, std::swap
+
+namespace eds {
+
+/****************************************************************************
+*localSharedPointer: shared ownership for single-threaded code at the least *
+*possible cost. The object lives in a block behind one 8-byte header        *
+*holding two 32-bit counts, strong and weak, so a handle is a single pointer*
+*and every count update is a plain 32-bit increment or decrement.           *
+*Keeping a handle on one thread is up to the caller. Nothing in the type    *
+*stops a lambda, std::thread or std::async from capturing a copy, and the   *
+*plain counts would then race. The API only keeps it apart from the         *
+*thread-safe types:                                                         *
+*  - there is no counting Policy parameter, the counts can never be atomic  *
+*  - it does not convert to or from sharedPointer, so it cannot end up in   *
+*    an atomicSharedPointer or any other type meant for sharing             *
+*  - objects only come from make_local_shared, there are no deleters, no    *
+*    allocator state and no converting constructors, the block knows T      *
+*The limit is 2^32 - 1 references of each kind. Debug builds assert that no *
+*count wraps, release builds do not check.                                  *
+****************************************************************************/
+template <typename T> class localSharedPointer;
+template <typename T> class localWeakPointer;
+
+// Block of a localSharedPointer: the two counts right in front of the object
+template <typename T, typename Alloc> class localBlock {
+  using blockAllocator = reboundAllocator<Alloc, localBlock>;
+  using blockTraits = std::allocator_traits<blockAllocator>;
+  using objectAllocator = reboundAllocator<Alloc, T>;
+  using objectTraits = std::allocator_traits<objectAllocator>;
+
+public:
+  template <typename... Args>
+  static localBlock *create(const Alloc &alloc, Args &&...args);
+  T *get() noexcept { return &object_; }
+  void add_shared() noexcept;
+  bool add_shared_if_alive() noexcept;
+  void release_shared() noexcept;
+  void add_weak() noexcept;
+  void release_weak() noexcept;
+  std::uint32_t shared_count() const noexcept { return shared_; }
+  // Weak owners, without the reference held for the strong ones
+  std::uint32_t weak_count() const noexcept {
+    return weak_ - (shared_ != 0 ? 1 : 0);
+  }
+
+private:
+  localBlock() noexcept {}
+  ~localBlock() {}
+
+  static constexpr std::uint32_t maxCount =
+      std::numeric_limits<std::uint32_t>::max();
+
+  std::uint32_t shared_ = 1;
+  // Holds one extra reference on behalf of all strong owners
+  std::uint32_t weak_ = 1;
+  // The union keeps the object from being constructed or destroyed implicitly
+  union {
+    T object_;
+  };
+};
+
+template <typename T, typename Alloc>
+template <typename... Args>
+localBlock<T, Alloc> *localBlock<T, Alloc>::create(const Alloc &alloc,
+                                                   Args &&...args) {
+  blockAllocator blockAlloc(alloc);
+  localBlock *block = blockTraits::allocate(blockAlloc, 1);
+  ::new (static_cast<void *>(block)) localBlock();
+  try {
+    objectAllocator objectAlloc(alloc);
+    objectTraits::construct(objectAlloc, block->get(),
+                            std::forward<Args>(args)...);
+  } catch (...) {
+    blockTraits::deallocate(blockAlloc, block, 1);
+    throw;
+  }
+  return block;
+}
+
+template <typename T, typename Alloc>
+void localBlock<T, Alloc>::add_shared() noexcept {
+  assert(shared_ != maxCount && "localSharedPointer count overflow");
+  ++shared_;
+}
+
+template <typename T, typename Alloc>
+bool localBlock<T, Alloc>::add_shared_if_alive() noexcept {
+  if (shared_ == 0) {
+    return false;
+  }
+  add_shared();
+  return true;
+}
+
+template <typename T, typename Alloc>
+void localBlock<T, Alloc>::add_weak() noexcept {
+  assert(weak_ != maxCount && "localWeakPointer count overflow");
+  ++weak_;
+}
+
+template <typename T, typename Alloc>
+void localBlock<T, Alloc>::release_shared() noexcept {
+  if (--shared_ == 0) {
+    objectAllocator objectAlloc{Alloc()};
+    objectTraits::destroy(objectAlloc, get());
+    release_weak();
+  }
+}
+
+template <typename T, typename Alloc>
+void localBlock<T, Alloc>::release_weak() noexcept {
+  if (--weak_ == 0) {
+    blockAllocator blockAlloc{Alloc()};
+    this->~localBlock();
+    blockTraits::deallocate(blockAlloc, this, 1);
+  }
+}
+
+// Local Shared Pointer class template, single-threaded and one pointer wide
+template <typename T> class localSharedPointer {
+public:
+  // Default constructor, owns nothing
+  localSharedPointer() noexcept;
+  // Constructor for nullptr
+  localSharedPointer(std::nullptr_t) noexcept;
+  // Copy constructor
+  localSharedPointer(const localSharedPointer &other) noexcept;
+  // Copy assignment operator
+  localSharedPointer &operator=(const localSharedPointer &other) noexcept;
+  // Move constructor
+  localSharedPointer(localSharedPointer &&other) noexcept;
+  // Move assignment operator
+  localSharedPointer &operator=(localSharedPointer &&other) noexcept;
+  // Destructor
+  ~localSharedPointer();
+  // Function to get the current use count
+  std::size_t use_count() const noexcept;
+  // Function to get the raw pointer
+  T *get() const noexcept;
+  // Dereference operator
+  T &operator*() const noexcept;
+  // Member access operator
+  T *operator->() const noexcept;
+  // Explicit conversion operator to bool
+  explicit operator bool() const noexcept;
+  // Drops the reference, owns nothing afterwards
+  void reset() noexcept;
+  // Swap function to exchange the contents with another local shared pointer
+  void swap(localSharedPointer &other) noexcept;
+  // Never shares with the thread-safe pointers
+  template <typename U, typename Policy>
+  localSharedPointer(const sharedPointer<U, Policy> &) = delete;
+
+private:
+  // The block is the only thing a handle stores, its allocator is stateless
+  using block = localBlock<T, defaultBlockAllocator<T>>;
+  // Adopting constructor, takes over a strong reference already counted
+  explicit localSharedPointer(block *control) noexcept;
+
+  block *control_;
+
+  template <typename U> friend class localWeakPointer;
+  template <typename U, typename... Args>
+  friend localSharedPointer<U> make_local_shared(Args &&...args);
+};
+
+// Default constructor
+template <typename T>
+localSharedPointer<T>::localSharedPointer() noexcept : control_(nullptr) {}
+
+// Constructor for nullptr
+template <typename T>
+localSharedPointer<T>::localSharedPointer(std::nullptr_t) noexcept
+    : control_(nullptr) {}
+
+// Adopting constructor
+template <typename T>
+localSharedPointer<T>::localSharedPointer(block *control) noexcept
+    : control_(control) {}
+
+// Copy constructor
+template <typename T>
+localSharedPointer<T>::localSharedPointer(
+    const localSharedPointer &other) noexcept
+    : control_(other.control_) {
+  if (control_ != nullptr) {
+    control_->add_shared();
+  }
+}
+
+// Copy assignment operator using copy-and-swap
+template <typename T>
+localSharedPointer<T> &
+localSharedPointer<T>::operator=(const localSharedPointer &other) noexcept {
+  localSharedPointer(other).swap(*this);
+  return *this;
+}
+
+// Move constructor
+template <typename T>
+localSharedPointer<T>::localSharedPointer(localSharedPointer &&other) noexcept
+    : control_(other.control_) {
+  other.control_ = nullptr;
+}
+
+// Move assignment operator
+template <typename T>
+localSharedPointer<T> &
+localSharedPointer<T>::operator=(localSharedPointer &&other) noexcept {
+  localSharedPointer(std::move(other)).swap(*this);
+  return *this;
+}
+
+// Destructor
+template <typename T> localSharedPointer<T>::~localSharedPointer() {
+  if (control_ != nullptr) {
+    control_->release_shared();
+  }
+}
+
+// Function to get the current use count
+template <typename T>
+std::size_t localSharedPointer<T>::use_count() const noexcept {
+  return control_ != nullptr ? control_->shared_count() : 0;
+}
+
+// Function to get the raw pointer
+template <typename T> T *localSharedPointer<T>::get() const noexcept {
+  return control_ != nullptr ? control_->get() : nullptr;
+}
+
+// Dereference operator
+template <typename T> T &localSharedPointer<T>::operator*() const noexcept {
+  return *control_->get();
+}
+
+// Member access operator
+template <typename T> T *localSharedPointer<T>::operator->() const noexcept {
+  return control_->get();
+}
+
+// Explicit conversion operator to bool
+template <typename T>
+localSharedPointer<T>::operator bool() const noexcept {
+  return control_ != nullptr;
+}
+
+// Drops the reference
+template <typename T> void localSharedPointer<T>::reset() noexcept {
+  localSharedPointer().swap(*this);
+}
+
+// Swap function
+template <typename T>
+void localSharedPointer<T>::swap(localSharedPointer &other) noexcept {
+  std::swap(control_, other.control_);
+}
+
+// Free function swap that calls upon the swap method of localSharedPointer
+template <typename T>
+void swap(localSharedPointer<T> &one, localSharedPointer<T> &other) noexcept {
+  one.swap(other);
+}
+
+// Make local shared function, the object lives right behind its two counts
+template <typename T, typename... Args>
+localSharedPointer<T> make_local_shared(Args &&...args) {
+  using block = typename localSharedPointer<T>::block;
+  return localSharedPointer<T>(
+      block::create(defaultBlockAllocator<T>(), std::forward<Args>(args)...));
+}
+
+// Local Weak Pointer class template, observes a localSharedPointer's object
+template <typename T> class localWeakPointer {
+public:
+  // Default constructor
+  localWeakPointer() noexcept;
+  // Constructor from localSharedPointer
+  localWeakPointer(const localSharedPointer<T> &other) noexcept;
+  // Copy constructor
+  localWeakPointer(const localWeakPointer &other) noexcept;
+  // Copy assignment operator
+  localWeakPointer &operator=(const localWeakPointer &other) noexcept;
+  // Move constructor
+  localWeakPointer(localWeakPointer &&other) noexcept;
+  // Move assignment operator
+  localWeakPointer &operator=(localWeakPointer &&other) noexcept;
+  // Destructor
+  ~localWeakPointer();
+  // Reset function
+  void reset() noexcept;
+  // Number of localWeakPointers observing the object, 0 once it expired
+  // (like weakPointer::use_count)
+  std::size_t use_count() const noexcept;
+  // Expired function
+  bool expired() const noexcept;
+  // Lock function to convert to localSharedPointer
+  localSharedPointer<T> lock() const noexcept;
+  // Swap method
+  void swap(localWeakPointer &other) noexcept;
+
+private:
+  using block = typename localSharedPointer<T>::block;
+
+  block *control_;
+};
+
+// Default constructor
+template <typename T>
+localWeakPointer<T>::localWeakPointer() noexcept : control_(nullptr) {}
+
+// Constructor from localSharedPointer
+template <typename T>
+localWeakPointer<T>::localWeakPointer(
+    const localSharedPointer<T> &other) noexcept
+    : control_(other.control_) {
+  if (control_ != nullptr) {
+    control_->add_weak();
+  }
+}
+
+// Copy constructor
+template <typename T>
+localWeakPointer<T>::localWeakPointer(const localWeakPointer &other) noexcept
+    : control_(other.control_) {
+  if (control_ != nullptr) {
+    control_->add_weak();
+  }
+}
+
+// Copy assignment operator using copy-and-swap
+template <typename T>
+localWeakPointer<T> &
+localWeakPointer<T>::operator=(const localWeakPointer &other) noexcept {
+  localWeakPointer(other).swap(*this);
+  return *this;
+}
+
+// Move constructor
+template <typename T>
+localWeakPointer<T>::localWeakPointer(localWeakPointer &&other) noexcept
+    : control_(other.control_) {
+  other.control_ = nullptr;
+}
+
+// Move assignment operator
+template <typename T>
+localWeakPointer<T> &
+localWeakPointer<T>::operator=(localWeakPointer &&other) noexcept {
+  localWeakPointer(std::move(other)).swap(*this);
+  return *this;
+}
+
+// Destructor
+template <typename T> localWeakPointer<T>::~localWeakPointer() {
+  if (control_ != nullptr) {
+    control_->release_weak();
+  }
+}
+
+// Reset function
+template <typename T> void localWeakPointer<T>::reset() noexcept {
+  localWeakPointer().swap(*this);
+}
+
+// Number of weak observers, as for weakPointer
+template <typename T>
+std::size_t localWeakPointer<T>::use_count() const noexcept {
+  return (control_ != nullptr && control_->shared_count() != 0)
+             ? control_->weak_count()
+             : 0;
+}
+
+// Expired function
+template <typename T> bool localWeakPointer<T>::expired() const noexcept {
+  return control_ == nullptr || control_->shared_count() == 0;
+}
+
+// Lock function, empty once the last strong owner is gone
+template <typename T>
+localSharedPointer<T> localWeakPointer<T>::lock() const noexcept {
+  if (control_ != nullptr && control_->add_shared_if_alive()) {
+    return localSharedPointer<T>(control_);
+  }
+  return localSharedPointer<T>();
+}
+
+// Swap method
+template <typename T>
+void localWeakPointer<T>::swap(localWeakPointer &other) noexcept {
+  std::swap(control_, other.control_);
+}
+
+} // namespace eds
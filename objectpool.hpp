@@ -0,0 +1,351 @@
+#pragma once
+#include "pool.hpp"
+#include "shared.hpp"
+#include "unique.hpp"
+#include <algorithm>     // For std::min
+#include <atomic>        // For std::atomic
+#include <cstddef>       // For std::size_t
+#include <cstdint>       // For std::uint64_t
+#include <functional>    // For std::function
+#include <mutex>         // For std::mutex, std::lock_guard
+#include <stdexcept>     // For std::invalid_argument
+#include <type_traits>   // For std::is_default_constructible
+#include <unordered_map> // For the registry of live pools
+#include <utility>       // For std::move
+#include <vector>        // For the caches
+
+namespace eds {
+
+/****************************************************************************
+*objectPool<T> recycles objects instead of deleting them. Handles come out  *
+*as uniquePointer<T, poolDeleter<T>> or sharedPointer<T>, and dropping the  *
+*last one hands the object back to its pool, after the optional reset hook  *
+*has put it into a clean state. Once the pool has warmed up, acquiring and  *
+*releasing never allocate (the control blocks of shared handles come from   *
+*pooledAllocator).                                                          *
+*Idle objects sit in a small cache of the thread that released them, up to  *
+*localCapacity. Beyond that half of them move to a shared overflow list     *
+*under a mutex, and a thread with an empty cache refills from there. The    *
+*overflow holds at most capacity objects, anything past it is deleted. The  *
+*thread caches come on top of that, so up to                                *
+*capacity + threads * (localCapacity + 1) objects can be idle at once.      *
+*Threads that exit give their cache back to the pool, or delete it if the   *
+*pool is gone already. Caches of destroyed pools are also deleted by the    *
+*next cache lookup of their thread. Handles must not outlive their pool.    *
+****************************************************************************/
+
+template <typename T> class objectPool;
+
+// Part of objectPool that does not depend on T: ids and per-thread caches
+class objectPoolBase {
+public:
+  objectPoolBase(const objectPoolBase &) = delete;
+  objectPoolBase &operator=(const objectPoolBase &) = delete;
+
+  // Objects a thread keeps for itself before spilling to the overflow
+  static constexpr std::size_t localCapacity = 32;
+
+protected:
+  // Idle objects of one pool on one thread
+  struct localCache {
+    std::uint64_t pool;
+    void (*destroy)(void *) noexcept;
+    std::vector<void *> items;
+  };
+
+  explicit objectPoolBase(void (*destroy)(void *) noexcept);
+  ~objectPoolBase() { unregister(); }
+
+  // Stops exiting threads from handing their caches to this pool. The first
+  // thing a derived destructor does, while its members are still alive
+  void unregister() noexcept;
+
+  // The calling thread's cache for this pool, created on first use
+  localCache &local_cache();
+  // Destroys and forgets the calling thread's cache for this pool
+  void drop_local_cache() noexcept;
+  // Takes over the cache of an exiting thread
+  virtual void absorb(std::vector<void *> &items) noexcept = 0;
+
+private:
+  // Live pools by id, never destroyed
+  struct registry {
+    std::mutex mutex;
+    std::unordered_map<std::uint64_t, objectPoolBase *> pools;
+  };
+  // Caches of one thread, given back when it exits
+  struct threadCaches {
+    std::vector<localCache> caches;
+    // Value of unregistered_ when the caches were last pruned, zero to start
+    // with like any thread_local
+    std::uint64_t seen;
+    ~threadCaches();
+  };
+
+  static registry &shared_state();
+  // Destroys the calling thread's caches of pools that are gone
+  static void prune_local_caches() noexcept;
+
+  const std::uint64_t id_;
+  void (*const destroy_)(void *) noexcept;
+
+  static inline std::atomic<std::uint64_t> nextId_{1};
+  // Pools unregistered so far, tells threads when to prune their caches
+  static inline std::atomic<std::uint64_t> unregistered_{0};
+  static inline thread_local threadCaches caches_;
+};
+
+inline objectPoolBase::objectPoolBase(void (*destroy)(void *) noexcept)
+    : id_(nextId_.fetch_add(1, std::memory_order_relaxed)), destroy_(destroy) {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  state.pools.emplace(id_, this);
+}
+
+inline void objectPoolBase::unregister() noexcept {
+  registry &state = shared_state();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (state.pools.erase(id_) != 0) {
+    unregistered_.fetch_add(1, std::memory_order_release);
+  }
+}
+
+inline objectPoolBase::registry &objectPoolBase::shared_state() {
+  // Never destroyed, threads may still exit while statics are torn down
+  static registry *state = new registry();
+  return *state;
+}
+
+inline objectPoolBase::localCache &objectPoolBase::local_cache() {
+  if (caches_.seen != unregistered_.load(std::memory_order_acquire)) {
+    prune_local_caches();
+  }
+  std::vector<localCache> &caches = caches_.caches;
+  for (localCache &cache : caches) {
+    if (cache.pool == id_) {
+      return cache;
+    }
+  }
+  caches.push_back({id_, destroy_, {}});
+  caches.back().items.reserve(localCapacity + 1);
+  return caches.back();
+}
+
+inline void objectPoolBase::drop_local_cache() noexcept {
+  std::vector<localCache> &caches = caches_.caches;
+  for (std::size_t i = 0; i < caches.size(); ++i) {
+    if (caches[i].pool == id_) {
+      for (void *item : caches[i].items) {
+        destroy_(item);
+      }
+      caches.erase(caches.begin() + static_cast<std::ptrdiff_t>(i));
+      return;
+    }
+  }
+}
+
+inline void objectPoolBase::prune_local_caches() noexcept {
+  std::vector<localCache> &caches = caches_.caches;
+  std::vector<localCache> dead;
+  {
+    registry &state = shared_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    caches_.seen = unregistered_.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < caches.size();) {
+      if (state.pools.count(caches[i].pool) == 0) {
+        try {
+          dead.push_back(std::move(caches[i]));
+        } catch (...) {
+          for (void *item : caches[i].items) {
+            caches[i].destroy(item);
+          }
+        }
+        caches[i] = std::move(caches.back());
+        caches.pop_back();
+      } else {
+        ++i;
+      }
+    }
+  }
+  // Outside the lock, the destructors may use pools themselves
+  for (localCache &cache : dead) {
+    for (void *item : cache.items) {
+      cache.destroy(item);
+    }
+  }
+}
+
+inline objectPoolBase::threadCaches::~threadCaches() {
+  registry &state = shared_state();
+  // Held throughout. A pool unregisters under it before anything of it is
+  // destroyed, so a pool found here is whole until absorb returns
+  std::lock_guard<std::mutex> lock(state.mutex);
+  for (localCache &cache : caches) {
+    auto found = state.pools.find(cache.pool);
+    if (found != state.pools.end()) {
+      found->second->absorb(cache.items);
+    } else {
+      for (void *item : cache.items) {
+        cache.destroy(item);
+      }
+    }
+  }
+}
+
+// Deleter handing the object back to its pool
+template <typename T> class poolDeleter {
+public:
+  explicit poolDeleter(objectPool<T> &pool) noexcept : pool_(&pool) {}
+  void operator()(T *ptr) const noexcept { pool_->recycle(ptr); }
+
+private:
+  objectPool<T> *pool_;
+};
+
+template <typename T> class objectPool final : public objectPoolBase {
+public:
+  // Creates the objects the pool hands out when it has none idle
+  using factory = std::function<T *()>;
+  // Brings a returned object back into a clean state
+  using resetHook = std::function<void(T &)>;
+
+  // Keeps up to capacity idle objects in the overflow, plus up to
+  // localCapacity + 1 in the cache of every thread that releases objects.
+  // reset runs on every returned object, create makes new ones (new T() by
+  // default). Throws std::invalid_argument without create if T has no
+  // default constructor
+  explicit objectPool(std::size_t capacity = 1024, resetHook reset = resetHook(),
+                      factory create = factory());
+  // Deletes the idle objects, no handle may be left by now
+  ~objectPool();
+
+  // An object, recycled if there is one idle
+  uniquePointer<T, poolDeleter<T>> acquire_unique();
+  // Same as a sharedPointer, its control block comes from pooledAllocator
+  template <typename Policy = nonAtomicCount>
+  sharedPointer<T, Policy> acquire_shared();
+  // Idle objects in the overflow (the thread caches are not counted)
+  std::size_t idle() const;
+
+private:
+  friend class poolDeleter<T>;
+
+  static void destroy(void *item) noexcept { delete static_cast<T *>(item); }
+  // Idle object or a new one
+  T *take();
+  // Returned object, reset and cached
+  void recycle(T *ptr) noexcept;
+  // Moves items to the overflow as far as capacity allows, deletes the rest
+  void spill(std::vector<void *> &items, std::size_t keep) noexcept;
+  void absorb(std::vector<void *> &items) noexcept override { spill(items, 0); }
+
+  const std::size_t capacity_;
+  resetHook reset_;
+  factory create_;
+  mutable std::mutex mutex_;
+  std::vector<void *> overflow_;
+};
+
+template <typename T>
+objectPool<T>::objectPool(std::size_t capacity, resetHook reset, factory create)
+    : objectPoolBase(&objectPool::destroy), capacity_(capacity),
+      reset_(std::move(reset)), create_(std::move(create)) {
+  if constexpr (!std::is_default_constructible<T>::value) {
+    if (!create_) {
+      throw std::invalid_argument(
+          "objectPool needs a factory for a T without default constructor");
+    }
+  }
+  overflow_.reserve(capacity_);
+}
+
+template <typename T> objectPool<T>::~objectPool() {
+  // Before any member goes, an exiting thread may be absorbing into it
+  unregister();
+  drop_local_cache();
+  for (void *item : overflow_) {
+    destroy(item);
+  }
+}
+
+template <typename T>
+uniquePointer<T, poolDeleter<T>> objectPool<T>::acquire_unique() {
+  return uniquePointer<T, poolDeleter<T>>(take(), poolDeleter<T>(*this));
+}
+
+template <typename T>
+template <typename Policy>
+sharedPointer<T, Policy> objectPool<T>::acquire_shared() {
+  return sharedPointer<T, Policy>(take(), poolDeleter<T>(*this),
+                                  pooledAllocator<T>());
+}
+
+template <typename T> std::size_t objectPool<T>::idle() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return overflow_.size();
+}
+
+template <typename T> T *objectPool<T>::take() {
+  localCache &cache = local_cache();
+  if (cache.items.empty()) {
+    // Refills half the cache at once, one lock for several acquisitions
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t count = std::min(overflow_.size(), localCapacity / 2);
+    cache.items.insert(cache.items.end(), overflow_.end() - count,
+                       overflow_.end());
+    overflow_.resize(overflow_.size() - count);
+  }
+  if (!cache.items.empty()) {
+    T *item = static_cast<T *>(cache.items.back());
+    cache.items.pop_back();
+    return item;
+  }
+  if constexpr (std::is_default_constructible<T>::value) {
+    if (!create_) {
+      return new T();
+    }
+  }
+  return create_();
+}
+
+template <typename T> void objectPool<T>::recycle(T *ptr) noexcept {
+  if (reset_) {
+    try {
+      reset_(*ptr);
+    } catch (...) {
+      // Not clean, so not reusable either
+      destroy(ptr);
+      return;
+    }
+  }
+  localCache *cache;
+  try {
+    cache = &local_cache();
+  } catch (...) {
+    // First release on this thread and no memory for its cache entry
+    destroy(ptr);
+    return;
+  }
+  // Reserved with the cache entry, this never allocates
+  cache->items.push_back(ptr);
+  if (cache->items.size() > localCapacity) {
+    spill(cache->items, localCapacity / 2);
+  }
+}
+
+template <typename T>
+void objectPool<T>::spill(std::vector<void *> &items, std::size_t keep) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  while (items.size() > keep) {
+    void *item = items.back();
+    items.pop_back();
+    if (overflow_.size() < capacity_) {
+      // Reserved up front, this never allocates
+      overflow_.push_back(item);
+    } else {
+      destroy(item);
+    }
+  }
+}
+
+} // namespace eds
@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>  // For std::atomic
+#include <cstddef> // For std::size_t
+
+namespace eds {
+
+/****************************************************************************
+*Counting policies decide how the strong and weak counts of a control block *
+*are stored and updated. Each policy provides a counts<Block> class that the *
+*control block derives from, Block being the control block type itself, so  *
+*a policy can reach back into the block when it needs to.                  *
+*Every counts class offers the same operations:                             *
+*  increment_shared / decrement_shared (true on the last strong reference)  *
+*  increment_shared_if_nonzero (used by lock, never revives a dead object)  *
+*  increment_weak / decrement_weak (true on the last weak reference)        *
+*  shared_count / weak_count                                                *
+*  is_unique (one strong owner and no weak one, with acquire ordering so    *
+*  the owner may write to the object, and exact even while other threads    *
+*  create and drop weak references)                                         *
+****************************************************************************/
+
+// Plain counters, no synchronization at all. Only for single-threaded use.
+struct nonAtomicCount {
+  template <typename Block> class counts {
+  public:
+    void increment_shared() noexcept { ++shared_; }
+    bool increment_shared_if_nonzero() noexcept {
+      if (shared_ == 0) {
+        return false;
+      }
+      ++shared_;
+      return true;
+    }
+    bool decrement_shared() noexcept { return --shared_ == 0; }
+    void increment_weak() noexcept { ++weak_; }
+    bool decrement_weak() noexcept { return --weak_ == 0; }
+    std::size_t shared_count() const noexcept { return shared_; }
+    std::size_t weak_count() const noexcept { return weak_; }
+    bool is_unique() const noexcept { return shared_ == 1 && weak_ == 1; }
+
+  private:
+    std::size_t shared_ = 1;
+    // Holds one extra reference on behalf of all strong owners
+    std::size_t weak_ = 1;
+  };
+};
+
+// Atomic counters, handles may be copied and dropped on any thread.
+struct atomicCount {
+  template <typename Block> class counts {
+  public:
+    // A new reference is always made from an existing one, nothing to order
+    void increment_shared() noexcept {
+      shared_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // CAS loop, once the count has reached zero it can never go up again
+    bool increment_shared_if_nonzero() noexcept {
+      std::size_t count = shared_.load(std::memory_order_relaxed);
+      while (count != 0) {
+        if (shared_.compare_exchange_weak(count, count + 1,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_relaxed)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    // Release publishes our writes to the object, acquire on the last
+    // decrement makes everybody else's writes visible to the destructor
+    bool decrement_shared() noexcept {
+      return shared_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    // Waits while is_unique has the weak count locked
+    void increment_weak() noexcept {
+      std::size_t count = weak_.load(std::memory_order_relaxed);
+      for (;;) {
+        if (count == locked) {
+          count = weak_.load(std::memory_order_relaxed);
+        } else if (weak_.compare_exchange_weak(count, count + 1,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed)) {
+          return;
+        }
+      }
+    }
+    bool decrement_weak() noexcept {
+      return weak_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    std::size_t shared_count() const noexcept {
+      return shared_.load(std::memory_order_relaxed);
+    }
+    std::size_t weak_count() const noexcept {
+      std::size_t count = weak_.load(std::memory_order_relaxed);
+      return count == locked ? 1 : count;
+    }
+    // Two plain loads could see the counts at different times (a weakPointer
+    // locked and then dropped in between), so the weak count is locked while
+    // the strong one is read. No weakPointer can be made meanwhile, and with
+    // none left nobody can become a strong owner but the caller. Acquire
+    // pairs with the release of the references dropped before, their
+    // accesses to the object happen before whatever the sole owner does next
+    bool is_unique() noexcept {
+      std::size_t expected = 1;
+      if (!weak_.compare_exchange_strong(expected, locked,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+        return false;
+      }
+      bool unique = shared_.load(std::memory_order_acquire) == 1;
+      weak_.store(1, std::memory_order_release);
+      return unique;
+    }
+
+  private:
+    // Weak count while is_unique runs
+    static constexpr std::size_t locked = ~std::size_t(0);
+
+    std::atomic<std::size_t> shared_{1};
+    // Holds one extra reference on behalf of all strong owners
+    std::atomic<std::size_t> weak_{1};
+  };
+};
+
+} // namespace eds
@@ -0,0 +1,209 @@
+#pragma once
+#include <atomic>  // For std::atomic
+#include <cstddef> // For std::size_t
+#include <cstdint> // For std::uintptr_t
+#include <mutex>   // For std::mutex, std::lock_guard
+#include <new>     // For std::align_val_t, std::bad_alloc
+#include <vector>  // For the free record list
+
+namespace eds {
+
+/****************************************************************************
+*Size-class pool for control blocks (and make_shared blocks of small T).    *
+*Every thread has its own record with one free list per 16-byte size class,*
+*so allocating and freeing on the same thread is a pointer pop and push     *
+*without any lock-prefixed instruction.                                     *
+*Blocks are carved out of 64 KiB slabs aligned to their size. A slab belongs*
+*to one record, found by masking a block's address. A block freed on        *
+*another thread is pushed onto a lock-free remote list of the record that   *
+*owns its slab, and the owner takes that whole list over once its local one *
+*runs dry.                                                                  *
+*Records of exited threads are handed to new threads together with their    *
+*slabs and free lists. Slabs are never given back to the system, the pool   *
+*keeps its high-water mark.                                                 *
+****************************************************************************/
+class blockPool {
+public:
+  // Largest request served from the pool, bigger ones go to operator new
+  static constexpr std::size_t maxSize = 256;
+  static constexpr std::size_t alignment = 16;
+
+  // True if bytes with the given alignment come from the pool
+  static constexpr bool pooled(std::size_t bytes, std::size_t align) noexcept {
+    return bytes <= maxSize && align <= alignment;
+  }
+  // Block of at least bytes, served from the calling thread's free lists
+  static void *allocate(std::size_t bytes);
+  // Gives back a block of the same size, from any thread
+  static void deallocate(void *ptr, std::size_t bytes) noexcept;
+
+private:
+  static constexpr std::size_t slabSize = std::size_t(1) << 16;
+  static constexpr std::size_t classCount = maxSize / alignment;
+
+  struct freeNode {
+    freeNode *next;
+  };
+  struct sizeClass {
+    freeNode *local_ = nullptr;
+    std::atomic<freeNode *> remote_{nullptr};
+    // Unused part of the slab currently being carved
+    char *next_ = nullptr;
+    char *end_ = nullptr;
+  };
+  // Sits at the start of every slab
+  struct slabHeader {
+    blockPool *owner;
+  };
+  // Unregisters the thread when it exits, see current()
+  struct exitGuard {
+    ~exitGuard();
+  };
+
+  static std::size_t class_of(std::size_t bytes) noexcept {
+    return bytes == 0 ? 0 : (bytes - 1) / alignment;
+  }
+  // Record of the calling thread, registers the thread on first use
+  static blockPool *current();
+  // Carves a block out of the current slab, starting a new one if needed
+  void *carve(std::size_t cls);
+  // Records of exited threads, reused by new threads so they never pile up
+  static std::vector<blockPool *> &free_records();
+  static std::mutex &registry_mutex();
+
+  sizeClass classes_[classCount];
+
+  static inline thread_local blockPool *record_ = nullptr;
+};
+
+inline void *blockPool::allocate(std::size_t bytes) {
+  blockPool *record = current();
+  sizeClass &cls = record->classes_[class_of(bytes)];
+  freeNode *node = cls.local_;
+  if (node == nullptr &&
+      cls.remote_.load(std::memory_order_relaxed) != nullptr) {
+    // Blocks other threads gave back, taken over all at once
+    node = cls.remote_.exchange(nullptr, std::memory_order_acquire);
+  }
+  if (node == nullptr) {
+    return record->carve(class_of(bytes));
+  }
+  cls.local_ = node->next;
+  return node;
+}
+
+inline void blockPool::deallocate(void *ptr, std::size_t bytes) noexcept {
+  auto *slab = reinterpret_cast<slabHeader *>(
+      reinterpret_cast<std::uintptr_t>(ptr) & ~(slabSize - 1));
+  sizeClass &cls = slab->owner->classes_[class_of(bytes)];
+  auto *node = static_cast<freeNode *>(ptr);
+  if (slab->owner == record_) {
+    node->next = cls.local_;
+    cls.local_ = node;
+    return;
+  }
+  // Another thread's block, only ever pushed here and taken as a whole list
+  // by the owner, so there is no ABA to worry about
+  freeNode *head = cls.remote_.load(std::memory_order_relaxed);
+  do {
+    node->next = head;
+  } while (!cls.remote_.compare_exchange_weak(head, node,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+}
+
+inline void *blockPool::carve(std::size_t cls) {
+  sizeClass &state = classes_[cls];
+  std::size_t size = (cls + 1) * alignment;
+  if (state.next_ == nullptr ||
+      static_cast<std::size_t>(state.end_ - state.next_) < size) {
+    char *slab = static_cast<char *>(
+        ::operator new(slabSize, std::align_val_t(slabSize)));
+    ::new (static_cast<void *>(slab)) slabHeader{this};
+    state.next_ = slab + alignment;
+    state.end_ = slab + slabSize;
+  }
+  void *block = state.next_;
+  state.next_ += size;
+  return block;
+}
+
+inline blockPool *blockPool::current() {
+  if (record_ == nullptr) {
+    blockPool *record = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(registry_mutex());
+      if (!free_records().empty()) {
+        record = free_records().back();
+        free_records().pop_back();
+      }
+    }
+    if (record == nullptr) {
+      record = new blockPool();
+    }
+    // Constructed on first use, its destructor runs when the thread exits
+    static thread_local exitGuard guard;
+    (void)guard;
+    record_ = record;
+  }
+  return record_;
+}
+
+inline std::vector<blockPool *> &blockPool::free_records() {
+  // Never destroyed, threads may still exit while statics are torn down
+  static std::vector<blockPool *> *records = new std::vector<blockPool *>();
+  return *records;
+}
+
+inline std::mutex &blockPool::registry_mutex() {
+  static std::mutex *mutex = new std::mutex();
+  return *mutex;
+}
+
+inline blockPool::exitGuard::~exitGuard() {
+  blockPool *record = record_;
+  // Blocks freed on this thread from now on take the remote path, the next
+  // thread to adopt the record picks them up
+  record_ = nullptr;
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  free_records().push_back(record);
+}
+
+// Standard allocator on top of blockPool, falls back to operator new for
+// anything too big or too aligned for it
+template <typename T> class pooledAllocator {
+public:
+  using value_type = T;
+
+  pooledAllocator() noexcept = default;
+  template <typename U> pooledAllocator(const pooledAllocator<U> &) noexcept {}
+
+  T *allocate(std::size_t n) {
+    if (n > std::size_t(-1) / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+    if (blockPool::pooled(n * sizeof(T), alignof(T))) {
+      return static_cast<T *>(blockPool::allocate(n * sizeof(T)));
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+  }
+  void deallocate(T *ptr, std::size_t n) noexcept {
+    if (blockPool::pooled(n * sizeof(T), alignof(T))) {
+      blockPool::deallocate(ptr, n * sizeof(T));
+    } else {
+      ::operator delete(ptr, std::align_val_t(alignof(T)));
+    }
+  }
+};
+
+// Stateless, any two pooledAllocators can free each other's memory
+template <typename T, typename U>
+bool operator==(const pooledAllocator<T> &, const pooledAllocator<U> &) noexcept {
+  return true;
+}
+template <typename T, typename U>
+bool operator!=(const pooledAllocator<T> &, const pooledAllocator<U> &) noexcept {
+  return false;
+}
+
+} // namespace eds
@@ -1,17 +1,340 @@
 #pragma once
-#include <utility> // For std::move
+#include <cstddef>     // For std::size_t, std::nullptr_t
+#include <memory>      // For std::allocator, std::allocator_traits
+#include <new>         // For placement new, std::bad_array_new_length
+#include <type_traits> // For std::remove_extent_t, std::is_array
+#include <typeinfo>    // For std::type_info
+#include <utility>     // For std::move
+#include "deleter.hpp"
+#include "instrument.hpp"
+#include "policy.hpp"
+#ifdef EDS_POOLED_BLOCKS
+#include "pool.hpp"
+#endif
 
 namespace eds {
-// Forward declaration of weakPointer
-template <typename T> class weakPointer;
+// Forward declarations, nonAtomicCount keeps the zero-overhead counting as default
+template <typename T, typename Policy = nonAtomicCount> class weakPointer;
+template <typename T, typename Policy = nonAtomicCount> class sharedPointer;
+template <typename T, typename Policy = nonAtomicCount>
+class enableSharedFromThis;
+template <typename T, typename Policy = nonAtomicCount> class sharedBatch;
+template <typename T, typename Policy> class sharedRef;
+template <typename Handle> class atomicSlot;
+
+/****************************************************************************
+*The control block keeps the strong and the weak count next to each other,  *
+*so a count change touches a single cache line. The weak count carries one  *
+*extra reference on behalf of all the strong owners together, which means   *
+*the block itself is released only after the object is gone and the last   *
+*weakPointer let go of it. How the counts are stored and updated is decided *
+*by the counting Policy (see policy.hpp).                                   *
+****************************************************************************/
+template <typename Policy>
+class controlBlock : public Policy::template counts<controlBlock<Policy>> {
+public:
+  controlBlock() = default;
+  controlBlock(const controlBlock &) = delete;
+  controlBlock &operator=(const controlBlock &) = delete;
+  // Adds a strong reference
+  void add_shared() noexcept { this->increment_shared(); }
+  // Adds a strong reference only if the object is still alive (used by lock)
+  bool add_shared_if_alive() noexcept {
+    return this->increment_shared_if_nonzero();
+  }
+  // Drops a strong reference, destroying the object on the last one
+  void release_shared() noexcept;
+  // Adds a weak reference
+  void add_weak() noexcept { this->increment_weak(); }
+  // Drops a weak reference, destroying the block on the last one
+  void release_weak() noexcept;
+  // Destroys the object and gives up the strong owners' weak reference,
+  // called once the last strong reference is gone
+  void expire() noexcept;
+  // Number of weakPointers (without the reference held by the strong owners)
+  std::size_t weak_count() const noexcept;
+  // The stored deleter if it is of the given type, nullptr otherwise
+  virtual void *get_deleter(const std::type_info &) noexcept { return nullptr; }
+
+protected:
+  virtual ~controlBlock() = default;
+
+private:
+  // Destroys the managed object
+  virtual void destroy_object() noexcept = 0;
+  // Frees the control block (and the object storage if it lives inside)
+  virtual void destroy_block() noexcept = 0;
+};
+
+template <typename Policy>
+void controlBlock<Policy>::release_shared() noexcept {
+  if (this->decrement_shared()) {
+    expire();
+  }
+}
+
+template <typename Policy>
+void controlBlock<Policy>::release_weak() noexcept {
+  if (this->decrement_weak()) {
+    destroy_block();
+  }
+}
+
+template <typename Policy> void controlBlock<Policy>::expire() noexcept {
+  destroy_object();
+  release_weak();
+}
+
+template <typename Policy>
+std::size_t controlBlock<Policy>::weak_count() const noexcept {
+  using counts = typename Policy::template counts<controlBlock<Policy>>;
+  return counts::weak_count() - (this->shared_count() != 0 ? 1 : 0);
+}
+
+/****************************************************************************
+*Control blocks are allocated through an allocator, which they keep (as an  *
+*empty base when it is stateless) so they can give their memory back to it. *
+*allocate_block and deallocate_block do this for every block type.          *
+****************************************************************************/
+// Allocator behind make_shared and sharedPointer(T*), define EDS_POOLED_BLOCKS
+// to take control blocks from the per-thread pool in pool.hpp instead of new
+#ifdef EDS_POOLED_BLOCKS
+template <typename T> using defaultBlockAllocator = pooledAllocator<T>;
+#else
+template <typename T> using defaultBlockAllocator = std::allocator<T>;
+#endif
+
+template <typename Alloc, typename U>
+using reboundAllocator =
+    typename std::allocator_traits<Alloc>::template rebind_alloc<U>;
+
+// Allocates a Block through alloc and constructs it with alloc and args
+template <typename Block, typename Alloc, typename... Args>
+Block *allocate_block(const Alloc &alloc, Args &&...args) {
+  reboundAllocator<Alloc, Block> blockAlloc(alloc);
+  using traits = std::allocator_traits<reboundAllocator<Alloc, Block>>;
+  Block *block = traits::allocate(blockAlloc, 1);
+  try {
+    ::new (static_cast<void *>(block)) Block(alloc, std::forward<Args>(args)...);
+  } catch (...) {
+    traits::deallocate(blockAlloc, block, 1);
+    throw;
+  }
+  return block;
+}
+
+// Destroys a Block and returns its memory to the allocator it keeps
+template <typename Block, typename Alloc>
+void deallocate_block(Block *block, const Alloc &alloc) noexcept {
+  // Copied out first, the block and its allocator are gone after the destructor
+  reboundAllocator<Alloc, Block> blockAlloc(alloc);
+  block->~Block();
+  std::allocator_traits<reboundAllocator<Alloc, Block>>::deallocate(blockAlloc,
+                                                                   block, 1);
+}
+
+// Control block for an object that was allocated separately (sharedPointer(T*)),
+// the deleter is type-erased here so it never shows up in sharedPointer's type
+template <typename T, typename D, typename Alloc, typename Policy>
+class pointerControlBlock final : public controlBlock<Policy>,
+                                  private eboStorage<D, 0>,
+                                  private eboStorage<Alloc, 1> {
+public:
+  pointerControlBlock(const Alloc &alloc, T *ptr, D &&deleter) noexcept
+      : eboStorage<D, 0>(std::move(deleter)), eboStorage<Alloc, 1>(alloc),
+        pointer_(ptr) {}
+  void *get_deleter(const std::type_info &type) noexcept override {
+    return type == typeid(D) ? &deleter() : nullptr;
+  }
+
+private:
+  D &deleter() noexcept { return eboStorage<D, 0>::value(); }
+  const Alloc &allocator() const noexcept {
+    return eboStorage<Alloc, 1>::value();
+  }
+  void destroy_object() noexcept override { deleter()(pointer_); }
+  void destroy_block() noexcept override {
+    Alloc alloc(allocator());
+    deallocate_block(this, alloc);
+  }
+
+  T *pointer_;
+};
+
+// Control block with the object stored inline (make_shared), one allocation.
+// The object is constructed and destroyed through the allocator as well, so
+// allocator-aware members (std::pmr containers) pick it up too
+template <typename T, typename Alloc, typename Policy>
+class inplaceControlBlock final : public controlBlock<Policy>,
+                                  private eboStorage<Alloc> {
+  using objectAllocator = reboundAllocator<Alloc, T>;
+  using objectTraits = std::allocator_traits<objectAllocator>;
 
-// Shared Pointer class template
-template <typename T> class sharedPointer {
 public:
+  template <typename... Args>
+  explicit inplaceControlBlock(const Alloc &alloc, Args &&...args)
+      : eboStorage<Alloc>(alloc) {
+    objectAllocator objectAlloc(alloc);
+    objectTraits::construct(objectAlloc, &object_, std::forward<Args>(args)...);
+  }
+  ~inplaceControlBlock() override {}
+  // Pointer to the inline object
+  T *get() noexcept { return &object_; }
+
+private:
+  const Alloc &allocator() const noexcept { return eboStorage<Alloc>::value(); }
+  void destroy_object() noexcept override {
+    objectAllocator objectAlloc(allocator());
+    objectTraits::destroy(objectAlloc, &object_);
+  }
+  void destroy_block() noexcept override {
+    Alloc alloc(allocator());
+    deallocate_block(this, alloc);
+  }
+
+  // The union keeps the object from being constructed or destroyed implicitly
+  union {
+    T object_;
+  };
+};
+
+// Control block with count elements stored right behind it (make_shared<T[]>
+// and the for_overwrite functions), one allocation however long the array is
+template <typename T, typename Alloc, typename Policy>
+class alignas(alignof(T) > alignof(std::max_align_t)
+                  ? alignof(T)
+                  : alignof(std::max_align_t)) inplaceArrayBlock final
+    : public controlBlock<Policy>,
+      private eboStorage<Alloc> {
+  using blockAllocator = reboundAllocator<Alloc, inplaceArrayBlock>;
+  using blockTraits = std::allocator_traits<blockAllocator>;
+  using objectAllocator = reboundAllocator<Alloc, T>;
+  using objectTraits = std::allocator_traits<objectAllocator>;
+
+public:
+  // Allocates a block with room for count elements and constructs them from
+  // args. Without args they are value-initialized, or default-initialized when
+  // they get overwritten anyway
+  template <typename... Args>
+  static inplaceArrayBlock *create(const Alloc &alloc, std::size_t count,
+                                   bool forOverwrite, const Args &...args);
+  ~inplaceArrayBlock() override = default;
+  // Pointer to the first element, they start right after the block
+  T *get() noexcept { return reinterpret_cast<T *>(this + 1); }
+
+private:
+  inplaceArrayBlock(const Alloc &alloc, std::size_t count) noexcept
+      : eboStorage<Alloc>(alloc), count_(count) {}
+  // Number of block-sized units holding the block and count elements
+  static std::size_t units(std::size_t count) noexcept {
+    return 1 + (count * sizeof(T) + sizeof(inplaceArrayBlock) - 1) /
+                   sizeof(inplaceArrayBlock);
+  }
+  const Alloc &allocator() const noexcept { return eboStorage<Alloc>::value(); }
+  // Destroys the first count elements, last one first
+  void destroy_elements(std::size_t count) noexcept;
+  void destroy_object() noexcept override { destroy_elements(count_); }
+  void destroy_block() noexcept override;
+
+  std::size_t count_;
+};
+
+template <typename T, typename Alloc, typename Policy>
+template <typename... Args>
+inplaceArrayBlock<T, Alloc, Policy> *
+inplaceArrayBlock<T, Alloc, Policy>::create(const Alloc &alloc,
+                                            std::size_t count,
+                                            bool forOverwrite,
+                                            const Args &...args) {
+  if (count > (std::size_t(-1) - sizeof(inplaceArrayBlock)) / sizeof(T)) {
+    throw std::bad_array_new_length();
+  }
+  blockAllocator blockAlloc(alloc);
+  inplaceArrayBlock *block = blockTraits::allocate(blockAlloc, units(count));
+  ::new (static_cast<void *>(block)) inplaceArrayBlock(alloc, count);
+  objectAllocator objectAlloc(alloc);
+  std::size_t built = 0;
+  try {
+    for (; built < count; ++built) {
+      if constexpr (sizeof...(Args) != 0) {
+        // Every element gets the same arguments, so they are never moved from
+        objectTraits::construct(objectAlloc, block->get() + built, args...);
+      } else if (forOverwrite) {
+        ::new (static_cast<void *>(block->get() + built)) T;
+      } else {
+        objectTraits::construct(objectAlloc, block->get() + built);
+      }
+    }
+  } catch (...) {
+    block->destroy_elements(built);
+    block->~inplaceArrayBlock();
+    blockTraits::deallocate(blockAlloc, block, units(count));
+    throw;
+  }
+  return block;
+}
+
+template <typename T, typename Alloc, typename Policy>
+void inplaceArrayBlock<T, Alloc, Policy>::destroy_elements(
+    std::size_t count) noexcept {
+  objectAllocator objectAlloc(allocator());
+  while (count != 0) {
+    objectTraits::destroy(objectAlloc, get() + --count);
+  }
+}
+
+template <typename T, typename Alloc, typename Policy>
+void inplaceArrayBlock<T, Alloc, Policy>::destroy_block() noexcept {
+  // Copied out first, the block and its allocator are gone after the destructor
+  blockAllocator blockAlloc(allocator());
+  std::size_t count = count_;
+  this->~inplaceArrayBlock();
+  blockTraits::deallocate(blockAlloc, this, units(count));
+}
+
+// Shared Pointer class template, Policy picks atomic or non-atomic counting
+template <typename T, typename Policy> class sharedPointer {
+public:
+  // T itself, or the element type for sharedPointer<T[]>
+  using element_type = std::remove_extent_t<T>;
+
+private:
+  // For sharedPointer<T[]>, raw pointers other than T* (or a less qualified
+  // T*), e.g. a Derived* that delete[] would then walk with the size of T.
+  // Control blocks are left to the adopting constructor
+  template <typename U>
+  using rejected = std::enable_if_t<
+      std::is_array<T>::value &&
+      !std::is_convertible<U (*)[], element_type (*)[]>::value &&
+      !std::is_convertible<U *, controlBlock<Policy> *>::value>;
+
+public:
+  // Default constructor, owns nothing
+  sharedPointer() noexcept;
   // Constructor for nullptr
   sharedPointer(std::nullptr_t) noexcept;
   // Explicit constructor taking a raw pointer
-  explicit sharedPointer(T *ptr = nullptr);
+  explicit sharedPointer(element_type *ptr);
+  // Constructor taking a raw pointer and the deleter to call on it instead of delete
+  template <typename D> sharedPointer(element_type *ptr, D deleter);
+  // Same, with the control block allocated through alloc
+  template <typename D, typename Alloc>
+  sharedPointer(element_type *ptr, D deleter, const Alloc &alloc);
+  // Arrays of another element type are not accepted, like std::shared_ptr<T[]>
+  template <typename U, typename = rejected<U>>
+  explicit sharedPointer(U *ptr) = delete;
+  template <typename U, typename D, typename = rejected<U>>
+  sharedPointer(U *ptr, D deleter) = delete;
+  template <typename U, typename D, typename Alloc, typename = rejected<U>>
+  sharedPointer(U *ptr, D deleter, const Alloc &alloc) = delete;
+  // Aliasing constructor, shares ownership with owner but points to ptr (a
+  // member or any other sub-object), no new control block
+  template <typename U>
+  sharedPointer(const sharedPointer<U, Policy> &owner,
+                element_type *ptr) noexcept;
+  // Same, taking over owner's reference instead of adding one
+  template <typename U>
+  sharedPointer(sharedPointer<U, Policy> &&owner, element_type *ptr) noexcept;
   // Copy constructor
   sharedPointer(const sharedPointer &other) noexcept;
   // Copy assignment operator
@@ -24,229 +347,502 @@ public:
   ~sharedPointer();
   // Function to get the current use count
   std::size_t use_count() const;
+  // True if this is the only owner and no weakPointer observes the object,
+  // the caller may then write to it even with atomic counts
+  bool unique() const noexcept;
   // Function to get the raw pointer
-  T *get() const;
+  element_type *get() const;
   // Dereference operator
-  T &operator*() const;
+  element_type &operator*() const;
   // Member access operator
-  T *operator->() const;
+  element_type *operator->() const;
+  // Element access, only for sharedPointer<T[]>
+  element_type &operator[](std::ptrdiff_t index) const;
   // Explicit conversion operator to bool
   explicit operator bool() const;
   // Function to reset the shared pointer with a new raw pointer
-  void reset(T *ptr = nullptr);
+  void reset(element_type *ptr = nullptr);
+  // Same, with the deleter to call on the new pointer
+  template <typename D> void reset(element_type *ptr, D deleter);
+  // Same, with the control block allocated through alloc
+  template <typename D, typename Alloc>
+  void reset(element_type *ptr, D deleter, const Alloc &alloc);
+  template <typename U, typename = rejected<U>> void reset(U *ptr) = delete;
+  template <typename U, typename D, typename = rejected<U>>
+  void reset(U *ptr, D deleter) = delete;
+  template <typename U, typename D, typename Alloc, typename = rejected<U>>
+  void reset(U *ptr, D deleter, const Alloc &alloc) = delete;
   // Swap function to exchange the contents with another shared pointer
   void swap(sharedPointer &other);
-  template <typename U> sharedPointer(const weakPointer<U> &weakPtr);
-  // Variadic template constructor for perfect forwarding of arguments
-  //template <typename... Args> sharedPointer(Args &&...args);
+  template <typename U> sharedPointer(const weakPointer<U, Policy> &weakPtr);
 
 private:
-  // Counter for shared ownership
-  std::size_t *counter_;
-  // Counter for weak ownership
-  std::size_t *weakCounter_;
+  // Adopting constructor, takes over a strong reference already counted in control
+  sharedPointer(controlBlock<Policy> *control, element_type *ptr) noexcept;
+  // Points the weak self-reference of an enableSharedFromThis object at this
+  // owner, unless it already has one
+  template <typename U>
+  void enable_weak_this(const enableSharedFromThis<U, Policy> *base) noexcept;
+  // Anything else has no self-reference to set up
+  void enable_weak_this(...) noexcept {}
 
   // Raw pointer to the owned resource
-  T *pointer_;
+  element_type *pointer_;
+  // Shared control block holding both counters
+  controlBlock<Policy> *control_;
 
   // Adding weakPointer as a frinedclass
-  template <typename U> friend class weakPointer;
+  template <typename U, typename P> friend class weakPointer;
+  template <typename U, typename P> friend class sharedPointer;
+  template <typename Handle> friend class atomicSlot;
+  template <typename U, typename P> friend class sharedRef;
+  template <typename U, typename P, typename Alloc, typename... Args>
+  friend sharedPointer<U, P> allocate_shared(const Alloc &alloc,
+                                             Args &&...args);
+  template <typename U, typename P, typename Alloc, typename... Args>
+  friend sharedPointer<U, P> allocate_shared_for_overwrite(const Alloc &alloc,
+                                                           Args &&...args);
+  template <typename D, typename U, typename P>
+  friend D *get_deleter(const sharedPointer<U, P> &ptr) noexcept;
+  template <typename U, typename P, typename Alloc, typename... Args>
+  friend sharedBatch<U, P> allocate_shared_batch(const Alloc &alloc,
+                                                 std::size_t count,
+                                                 const Args &...args);
 };
 
+// Default constructor
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::sharedPointer() noexcept
+    : pointer_(nullptr), control_(nullptr) {}
+
 // Constructor for nullptr
-template <typename T>
-sharedPointer<T>::sharedPointer(std::nullptr_t) noexcept
-    : counter_(nullptr), weakCounter_(nullptr), pointer_(nullptr) {}
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::sharedPointer(std::nullptr_t) noexcept
+    : pointer_(nullptr), control_(nullptr) {}
 
 // Constructor taking a raw pointer
-template <typename T>
-sharedPointer<T>::sharedPointer(T *ptr)
-    : counter_(new std::size_t(1)), weakCounter_(new std::size_t(0)),
-      pointer_(ptr) {}
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::sharedPointer(element_type *ptr)
+    : sharedPointer(ptr, defaultDelete<T>()) {}
 
-// Copy constructor
-template <typename T>
-sharedPointer<T>::sharedPointer(const sharedPointer &other) noexcept
-    : counter_{other.counter_},
-      weakCounter_{other.weakCounter_}, pointer_{other.pointer_} {
-  ++(*counter_);
-}
+// Constructor taking a raw pointer and its deleter
+template <typename T, typename Policy>
+template <typename D>
+sharedPointer<T, Policy>::sharedPointer(element_type *ptr, D deleter)
+    : sharedPointer(ptr, std::move(deleter),
+                    defaultBlockAllocator<element_type>()) {}
 
-// Copy assignment operator
-template <typename T>
-sharedPointer<T> &
-sharedPointer<T>::operator=(const sharedPointer &other) noexcept {
-  if (this != &other) {
-    if (--(*counter_) == 0) {
-      delete counter_;
-      delete weakCounter_;
-      delete pointer_;
+// Constructor taking a raw pointer, its deleter and the control block allocator
+template <typename T, typename Policy>
+template <typename D, typename Alloc>
+sharedPointer<T, Policy>::sharedPointer(element_type *ptr, D deleter,
+                                        const Alloc &alloc)
+    : pointer_(ptr), control_(nullptr) {
+  if (ptr != nullptr) {
+    try {
+      control_ =
+          allocate_block<pointerControlBlock<element_type, D, Alloc, Policy>>(
+              alloc, ptr, std::move(deleter));
+    } catch (...) {
+      // The pointer was handed to us, so we still own it if the block fails
+      deleter(ptr);
+      throw;
     }
-    counter_ = other.counter_;
-    weakCounter_ = other.weakCounter_;
-    pointer_ = other.pointer_;
-    ++(*counter_);
+    enable_weak_this(ptr);
+    EDS_COUNT(T, construction);
+    EDS_COUNT(T, block_allocation);
+  }
+}
+
+// Aliasing constructor
+template <typename T, typename Policy>
+template <typename U>
+sharedPointer<T, Policy>::sharedPointer(const sharedPointer<U, Policy> &owner,
+                                        element_type *ptr) noexcept
+    : pointer_(ptr), control_(owner.control_) {
+  if (control_ != nullptr) {
+    control_->add_shared();
+    EDS_COUNT(T, copy);
   }
+}
+
+// Aliasing constructor taking over the owner's reference
+template <typename T, typename Policy>
+template <typename U>
+sharedPointer<T, Policy>::sharedPointer(sharedPointer<U, Policy> &&owner,
+                                        element_type *ptr) noexcept
+    : pointer_(ptr), control_(owner.control_) {
+  owner.pointer_ = nullptr;
+  owner.control_ = nullptr;
+  if (control_ != nullptr) {
+    EDS_COUNT(T, move);
+  }
+}
 
+// Adopting constructor, only ever used on a freshly allocated block
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::sharedPointer(controlBlock<Policy> *control,
+                                        element_type *ptr) noexcept
+    : pointer_(ptr), control_(control) {
+  EDS_COUNT(T, construction);
+  EDS_COUNT(T, block_allocation);
+}
+
+// Copy constructor
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::sharedPointer(const sharedPointer &other) noexcept
+    : pointer_{other.pointer_}, control_{other.control_} {
+  if (control_ != nullptr) {
+    control_->add_shared();
+    EDS_COUNT(T, copy);
+  }
+}
+
+// Copy assignment operator
+template <typename T, typename Policy>
+sharedPointer<T, Policy> &
+sharedPointer<T, Policy>::operator=(const sharedPointer &other) noexcept {
+  // Copy first so that self-assignment and aliasing owners stay alive
+  sharedPointer(other).swap(*this);
   return *this;
 }
 
 // Move constructor
-template <typename T>
-sharedPointer<T>::sharedPointer(sharedPointer &&other) noexcept
-    : counter_{other.counter_},
-      weakCounter_{other.weakCounter_}, pointer_{other.pointer_} {
-  other.counter_ = nullptr;
-  other.weakCounter_ = nullptr;
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::sharedPointer(sharedPointer &&other) noexcept
+    : pointer_{other.pointer_}, control_{other.control_} {
   other.pointer_ = nullptr;
+  other.control_ = nullptr;
+  // Like destructions, only handles that own something are counted
+  if (control_ != nullptr) {
+    EDS_COUNT(T, move);
+  }
 }
 
 // Move assignment operator
-template <typename T>
-sharedPointer<T> &sharedPointer<T>::operator=(sharedPointer &&other) noexcept {
+template <typename T, typename Policy>
+sharedPointer<T, Policy> &
+sharedPointer<T, Policy>::operator=(sharedPointer &&other) noexcept {
   if (this != &other) {
-    if (--(*counter_) == 0) {
-      delete counter_;
-      delete weakCounter_;
-      delete pointer_;
-    }
-    counter_ = other.counter_;
-    weakCounter_ = other.weakCounter_;
-    pointer_ = other.pointer_;
-    other.counter_ = nullptr;
-    weakCounter_ = nullptr;
-    other.pointer_ = nullptr;
+    sharedPointer(std::move(other)).swap(*this);
   }
-
   return *this;
 }
 
 // Destructor
-template <typename T> sharedPointer<T>::~sharedPointer() {
-  if (counter_ != nullptr) {
-    if (--(*counter_) == 0) {
-      delete counter_;
-      counter_=nullptr;
-
-      if (pointer_ != nullptr) {
-        delete pointer_;
-        pointer_=nullptr;
-        // Decrement the weak counter only if it's not null
-        if (weakCounter_ != nullptr) {
-          --(*weakCounter_);
-        }
-      }
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::~sharedPointer() {
+  if (control_ != nullptr) {
+    EDS_COUNT(T, destruction);
+    control_->release_shared();
+  }
+}
+
+// Allocate shared function, the object and its control block come from alloc
+// in one allocation and go back to it when the last reference is gone.
+// For T[] the only argument is the number of (value-initialized) elements
+template <typename T, typename Policy = nonAtomicCount, typename Alloc,
+          typename... Args>
+sharedPointer<T, Policy> allocate_shared(const Alloc &alloc, Args &&...args) {
+  if constexpr (std::is_array<T>::value) {
+    static_assert(std::extent<T>::value == 0 && sizeof...(Args) == 1,
+                  "allocate_shared<T[]> takes the number of elements");
+    auto *block = inplaceArrayBlock<std::remove_extent_t<T>, Alloc,
+                                    Policy>::create(alloc, std::size_t(args...),
+                                                    false);
+    return sharedPointer<T, Policy>(block, block->get());
+  } else {
+    auto *block = allocate_block<inplaceControlBlock<T, Alloc, Policy>>(
+        alloc, std::forward<Args>(args)...);
+    sharedPointer<T, Policy> result(block, block->get());
+    result.enable_weak_this(result.pointer_);
+    return result;
+  }
+}
+
+// Same, but the object (or every element for T[], whose only argument is the
+// number of elements) is default-initialized. Saves zeroing big buffers that
+// get overwritten right away
+template <typename T, typename Policy = nonAtomicCount, typename Alloc,
+          typename... Args>
+sharedPointer<T, Policy> allocate_shared_for_overwrite(const Alloc &alloc,
+                                                       Args &&...args) {
+  if constexpr (std::is_array<T>::value) {
+    static_assert(std::extent<T>::value == 0 && sizeof...(Args) == 1,
+                  "allocate_shared_for_overwrite<T[]> takes the number of elements");
+    auto *block = inplaceArrayBlock<std::remove_extent_t<T>, Alloc,
+                                    Policy>::create(alloc, std::size_t(args...),
+                                                    true);
+    return sharedPointer<T, Policy>(block, block->get());
+  } else {
+    static_assert(sizeof...(Args) == 0,
+                  "allocate_shared_for_overwrite<T> takes no constructor arguments");
+    auto *block = inplaceArrayBlock<T, Alloc, Policy>::create(alloc, 1, true);
+    sharedPointer<T, Policy> result(block, block->get());
+    result.enable_weak_this(result.pointer_);
+    return result;
+  }
+}
+
+// The deleter ptr was created with, nullptr if it has none of type D
+template <typename D, typename T, typename Policy>
+D *get_deleter(const sharedPointer<T, Policy> &ptr) noexcept {
+  if (ptr.control_ == nullptr) {
+    return nullptr;
+  }
+  return static_cast<D *>(ptr.control_->get_deleter(typeid(D)));
+}
+
+// Make shared function, the object lives inside its control block
+template <typename T, typename Policy = nonAtomicCount, typename... Args>
+sharedPointer<T, Policy> make_shared(Args &&...args) {
+  return allocate_shared<T, Policy>(
+      defaultBlockAllocator<std::remove_extent_t<T>>(),
+      std::forward<Args>(args)...);
+}
+
+// Make shared function without value-initialization, see
+// allocate_shared_for_overwrite
+template <typename T, typename Policy = nonAtomicCount, typename... Args>
+sharedPointer<T, Policy> make_shared_for_overwrite(Args &&...args) {
+  return allocate_shared_for_overwrite<T, Policy>(
+      defaultBlockAllocator<std::remove_extent_t<T>>(),
+      std::forward<Args>(args)...);
+}
+
+/****************************************************************************
+*sharedBatch: count objects built in one allocation together with a single *
+*control block, for objects that live and die together. The batch iterates *
+*like an array (begin/end over T), and handle(i) gives an aliasing          *
+*sharedPointer<T> to one element that keeps the whole batch alive. Copying  *
+*handles touches the one shared counter pair, no allocation per object.     *
+****************************************************************************/
+template <typename T, typename Policy> class sharedBatch {
+public:
+  using element_type = T;
+  using iterator = T *;
+
+  // Empty batch
+  sharedBatch() noexcept : size_(0) {}
+  // Number of objects
+  std::size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  // The objects, contiguous in memory
+  T *begin() const noexcept { return elements_.get(); }
+  T *end() const noexcept { return elements_.get() + size_; }
+  T &operator[](std::size_t index) const noexcept { return elements_[index]; }
+  // Owner of element index, shares the batch's control block
+  sharedPointer<T, Policy> handle(std::size_t index) const noexcept {
+    return sharedPointer<T, Policy>(elements_, elements_.get() + index);
+  }
+  // Owner of the whole batch
+  const sharedPointer<T[], Policy> &owner() const noexcept { return elements_; }
+
+private:
+  sharedBatch(sharedPointer<T[], Policy> elements, std::size_t size) noexcept
+      : elements_(std::move(elements)), size_(size) {}
+
+  sharedPointer<T[], Policy> elements_;
+  std::size_t size_;
+
+  template <typename U, typename P, typename Alloc, typename... Args>
+  friend sharedBatch<U, P> allocate_shared_batch(const Alloc &alloc,
+                                                 std::size_t count,
+                                                 const Args &...args);
+};
+
+// Tells whether T derives from enableSharedFromThis, never called
+template <typename Policy, typename U>
+std::true_type shares_from_this(const enableSharedFromThis<U, Policy> *);
+template <typename Policy> std::false_type shares_from_this(...);
+
+// Builds count objects, each from the same args, in one block from alloc
+template <typename T, typename Policy = nonAtomicCount, typename Alloc,
+          typename... Args>
+sharedBatch<T, Policy> allocate_shared_batch(const Alloc &alloc,
+                                             std::size_t count,
+                                             const Args &...args) {
+  static_assert(!std::is_array<T>::value,
+                "allocate_shared_batch takes the element type");
+  auto *block = inplaceArrayBlock<T, Alloc, Policy>::create(alloc, count,
+                                                            false, args...);
+  sharedPointer<T[], Policy> elements(block, block->get());
+  if constexpr (decltype(shares_from_this<Policy>(
+                    static_cast<T *>(nullptr)))::value) {
+    for (std::size_t i = 0; i < count; ++i) {
+      // Each element's shared_from_this hands out its own handle
+      sharedPointer<T, Policy>(elements, elements.get() + i)
+          .enable_weak_this(elements.get() + i);
     }
   }
+  return sharedBatch<T, Policy>(std::move(elements), count);
 }
 
-// Make shared function to create a shared pointer with dynamic allocation
-template <typename T, typename... Args>
-sharedPointer<T> make_shared(Args &&...args) {
-  return sharedPointer<T>(new T(std::forward<Args>(args)...));
+// Same, with the block from the default allocator
+template <typename T, typename Policy = nonAtomicCount, typename... Args>
+sharedBatch<T, Policy> make_shared_batch(std::size_t count,
+                                         const Args &...args) {
+  return allocate_shared_batch<T, Policy>(defaultBlockAllocator<T>(), count,
+                                          args...);
 }
 
 // Function to get the current use count
-template <typename T> std::size_t sharedPointer<T>::use_count() const {
-  return (counter_ != nullptr) ? *counter_ : 0;
+template <typename T, typename Policy>
+std::size_t sharedPointer<T, Policy>::use_count() const {
+  return (control_ != nullptr) ? control_->shared_count() : 0;
+}
+
+// True if this is the only owner and nothing observes the object
+template <typename T, typename Policy>
+bool sharedPointer<T, Policy>::unique() const noexcept {
+  return control_ != nullptr && control_->is_unique();
 }
 
 // Function to get the raw pointer
-template <typename T> T *sharedPointer<T>::get() const { return pointer_; }
+template <typename T, typename Policy>
+typename sharedPointer<T, Policy>::element_type *
+sharedPointer<T, Policy>::get() const { return pointer_; }
 
 // Dereference operator
-template <typename T> T &sharedPointer<T>::operator*() const {
+template <typename T, typename Policy>
+typename sharedPointer<T, Policy>::element_type &
+sharedPointer<T, Policy>::operator*() const {
   return *pointer_;
 }
 
 // Member access operator
-template <typename T> T *sharedPointer<T>::operator->() const {
+template <typename T, typename Policy>
+typename sharedPointer<T, Policy>::element_type *
+sharedPointer<T, Policy>::operator->() const {
   return pointer_;
 }
 
+// Element access
+template <typename T, typename Policy>
+typename sharedPointer<T, Policy>::element_type &
+sharedPointer<T, Policy>::operator[](std::ptrdiff_t index) const {
+  static_assert(std::is_array<T>::value, "operator[] needs sharedPointer<T[]>");
+  return pointer_[index];
+}
+
 // Explicit conversion operator to bool
-template <typename T> sharedPointer<T>::operator bool() const {
+template <typename T, typename Policy>
+sharedPointer<T, Policy>::operator bool() const {
   return pointer_ != nullptr;
 }
 
-template <typename T> void sharedPointer<T>::reset(T *ptr) {
+// Reset releases the current ownership and optionally takes over ptr
+template <typename T, typename Policy>
+void sharedPointer<T, Policy>::reset(element_type *ptr) {
   if (ptr != nullptr) {
-    if (--(*counter_) == 0) {
-      delete counter_;
-      delete pointer_;
-      pointer_=nullptr;
-      counter_=nullptr;
-      --(*weakCounter_);
-    }
-    counter_ = new std::size_t(1);
-    weakCounter_ = new std::size_t(0);
-    pointer_ = ptr;
+    sharedPointer(ptr).swap(*this);
   } else {
-    if (--(*counter_) == 0) {
-      delete counter_;
-      delete pointer_;
-      --(*weakCounter_);
-      pointer_=nullptr;
-      counter_=nullptr;
-    }
+    sharedPointer().swap(*this);
   }
 }
 
+// Reset with a custom deleter for the new pointer
+template <typename T, typename Policy>
+template <typename D>
+void sharedPointer<T, Policy>::reset(element_type *ptr, D deleter) {
+  sharedPointer(ptr, std::move(deleter)).swap(*this);
+}
+
+// Reset with a custom deleter and control block allocator for the new pointer
+template <typename T, typename Policy>
+template <typename D, typename Alloc>
+void sharedPointer<T, Policy>::reset(element_type *ptr, D deleter,
+                                     const Alloc &alloc) {
+  sharedPointer(ptr, std::move(deleter), alloc).swap(*this);
+}
+
 // Swap function to exchange the contents with another shared pointer
-template <typename T> void sharedPointer<T>::swap(sharedPointer &other) {
-  std::swap(counter_, other.counter_);
+template <typename T, typename Policy>
+void sharedPointer<T, Policy>::swap(sharedPointer &other) {
   std::swap(pointer_, other.pointer_);
-  std::swap(weakCounter_, other.weakCounter_);
+  std::swap(control_, other.control_);
 }
 
 // free function swap
-template <typename T>
-void swap(sharedPointer<T> &one, sharedPointer<T> &other) {
+template <typename T, typename Policy>
+void swap(sharedPointer<T, Policy> &one, sharedPointer<T, Policy> &other) {
   one.swap(other);
 }
 
-/****************************************************************************
-*If Variadic Template were uncommented the code would work but the initiali-*
-*-zation of copy constructors would never bee called it would forward to the*
-*Variadic template construcor as it is a better match example:              *
-*sharedPointer<MyClass> ptr2(ptr1) would call Variadic template instead of  *
-*the usual copy constructor that is defined in this header file             *
-*Have no clue why it is a better candidate for that than copy constructor   *
-****************************************************************************/
+// Casts sharing ownership with ptr through the aliasing constructor. The
+// rvalue versions take over ptr's reference instead of adding one, so a cast
+// of a temporary or a moved handle costs no count update at all
+template <typename T, typename U, typename Policy>
+sharedPointer<T, Policy>
+static_pointer_cast(const sharedPointer<U, Policy> &ptr) noexcept {
+  using element = typename sharedPointer<T, Policy>::element_type;
+  return sharedPointer<T, Policy>(ptr, static_cast<element *>(ptr.get()));
+}
+template <typename T, typename U, typename Policy>
+sharedPointer<T, Policy>
+static_pointer_cast(sharedPointer<U, Policy> &&ptr) noexcept {
+  using element = typename sharedPointer<T, Policy>::element_type;
+  element *cast = static_cast<element *>(ptr.get());
+  return sharedPointer<T, Policy>(std::move(ptr), cast);
+}
 
-// // Variadic template constructor for perfect forwarding of arguments
-// template <typename T>
-// template <typename... Args>
-// sharedPointer<T>::sharedPointer(Args &&...args) : pointer_(nullptr) {
-//   if constexpr ((std::is_same<sharedPointer<T>, std::decay_t<Args>>::value ||
-//                  ...)) {
-//     // If any argument is a sharedPointer, initialize counter_ and pointer_
-//     ((counter_ = args.counter_, weakCounter_ = args.weakCounter_,
-//       pointer_ = args.pointer_, ++(*counter_)),
-//      ...);
-//   } else {
-//     // Otherwise, initialize pointer_ with new T and counter_ with 1
-//     pointer_ = new T(std::forward<Args>(args)...);
-//     counter_ = new std::size_t(1);
-//     weakCounter_ = new std::size_t(0);
-//   }
-// }
+// Empty if the object is no T, ptr then keeps its reference
+template <typename T, typename U, typename Policy>
+sharedPointer<T, Policy>
+dynamic_pointer_cast(const sharedPointer<U, Policy> &ptr) noexcept {
+  using element = typename sharedPointer<T, Policy>::element_type;
+  if (element *cast = dynamic_cast<element *>(ptr.get())) {
+    return sharedPointer<T, Policy>(ptr, cast);
+  }
+  return sharedPointer<T, Policy>();
+}
+template <typename T, typename U, typename Policy>
+sharedPointer<T, Policy>
+dynamic_pointer_cast(sharedPointer<U, Policy> &&ptr) noexcept {
+  using element = typename sharedPointer<T, Policy>::element_type;
+  if (element *cast = dynamic_cast<element *>(ptr.get())) {
+    return sharedPointer<T, Policy>(std::move(ptr), cast);
+  }
+  return sharedPointer<T, Policy>();
+}
+
+template <typename T, typename U, typename Policy>
+sharedPointer<T, Policy>
+const_pointer_cast(const sharedPointer<U, Policy> &ptr) noexcept {
+  using element = typename sharedPointer<T, Policy>::element_type;
+  return sharedPointer<T, Policy>(ptr, const_cast<element *>(ptr.get()));
+}
+template <typename T, typename U, typename Policy>
+sharedPointer<T, Policy>
+const_pointer_cast(sharedPointer<U, Policy> &&ptr) noexcept {
+  using element = typename sharedPointer<T, Policy>::element_type;
+  element *cast = const_cast<element *>(ptr.get());
+  return sharedPointer<T, Policy>(std::move(ptr), cast);
+}
 
 //Creating a shared pointer from a weakPointer(used for lock method in weakPointer....)
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-sharedPointer<T>::sharedPointer(const weakPointer<U> &weakPtr) {
-  if (weakPtr.weakCounter_ != nullptr) {
-    counter_ = weakPtr.sharedCounter_;
-    weakCounter_ = weakPtr.weakCounter_;
+sharedPointer<T, Policy>::sharedPointer(const weakPointer<U, Policy> &weakPtr)
+    : pointer_(nullptr), control_(nullptr) {
+  // The object can only be shared again while some strong owner keeps it alive
+  if (weakPtr.control_ != nullptr && weakPtr.control_->add_shared_if_alive()) {
     pointer_ = weakPtr.pointer_;
-    ++(*counter_);
+    control_ = weakPtr.control_;
+    EDS_COUNT(T, lock_success);
   } else {
-    // Handle the case where the weak pointer is invalid
-    counter_ = nullptr;
-    weakCounter_ = nullptr;
-    pointer_ = nullptr;
+    EDS_COUNT(T, lock_failure);
+  }
+}
+
+// Sets up the self-reference, only the first owner of the object does
+template <typename T, typename Policy>
+template <typename U>
+void sharedPointer<T, Policy>::enable_weak_this(
+    const enableSharedFromThis<U, Policy> *base) noexcept {
+  if (base->weakThis_.expired()) {
+    base->weakThis_ = weakPointer<U, Policy>(*this);
   }
 }
 
-} // namespace eds
\ No newline at end of file
+} // namespace eds
@@ -5,10 +5,36 @@
  *							                                        *
  ********************************************************/
 
+// The tests also cover the optional counters, see instrument.hpp
+#define EDS_INSTRUMENTATION
+
+#include "atomic.hpp"
+#include "biased.hpp"
+#include "borrowed.hpp"
+#include "cache.hpp"
+#include "compressed.hpp"
+#include "cow.hpp"
+#include "cycle.hpp"
+#include "deferred.hpp"
+#include "epoch.hpp"
+#include "handoff.hpp"
+#include "inline.hpp"
+#include "intrusive.hpp"
+#include "local.hpp"
+#include "objectpool.hpp"
+#include "pool.hpp"
 #include "shared.hpp"
 #include "unique.hpp"
 #include "weak.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory_resource>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 class MyClass {
 public:
@@ -46,6 +72,122 @@ private:
   int data;
 };
 
+// Stateless deleter for memory that came from std::malloc
+struct freeDeleter {
+  void operator()(int *ptr) const noexcept { std::free(ptr); }
+};
+
+// Non-pointer handle, -1 means "owns nothing"
+struct descriptorHandle {
+  int fd = -1;
+  bool operator==(const descriptorHandle &other) const { return fd == other.fd; }
+  bool operator!=(const descriptorHandle &other) const { return fd != other.fd; }
+};
+struct descriptorDeleter {
+  using pointer = descriptorHandle;
+  void operator()(descriptorHandle handle) const {
+    std::cout << "Closing descriptor " << handle.fd << std::endl;
+  }
+};
+
+// Memory resource that counts what goes through it before passing it on
+class countingResource : public std::pmr::memory_resource {
+public:
+  explicit countingResource(std::pmr::memory_resource *upstream)
+      : upstream_(upstream) {}
+  int allocations = 0;
+  int deallocations = 0;
+
+private:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    ++allocations;
+    return upstream_->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override {
+    ++deallocations;
+    upstream_->deallocate(ptr, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+  std::pmr::memory_resource *upstream_;
+};
+
+// Type carrying its own reference count
+class countedClass : public eds::refCounted<countedClass, eds::atomicCount> {
+public:
+  explicit countedClass(int value) : data(value) {
+    std::cout << "countedClass Constructor, Data: " << data << std::endl;
+  }
+  ~countedClass() {
+    std::cout << "countedClass Destructor, Data: " << data << std::endl;
+  }
+  int data;
+};
+
+// Object handing out sharedPointers to itself
+class selfAware : public eds::enableSharedFromThis<selfAware> {
+public:
+  explicit selfAware(int value) : data(value) {}
+  eds::sharedPointer<selfAware> self() { return shared_from_this(); }
+  int data;
+};
+
+// Object whose member is shared separately from it
+struct outerClass {
+  explicit outerClass(int value) : member(value) {}
+  MyClass member;
+};
+
+// Small polymorphic strategies, one fits an inlineUniquePointer and one not
+struct strategy {
+  virtual ~strategy() = default;
+  virtual int apply(int value) const = 0;
+};
+struct addStrategy : strategy {
+  explicit addStrategy(int amount) : amount(amount) {}
+  int apply(int value) const override { return value + amount; }
+  int amount;
+};
+struct tableStrategy : strategy {
+  explicit tableStrategy(int fill) {
+    for (int &entry : table) {
+      entry = fill;
+    }
+  }
+  int apply(int value) const override { return value * table[value % 64]; }
+  int table[64];
+};
+
+// True if Owner::reset accepts a U*
+template <typename Owner, typename U, typename = void>
+struct resettable : std::false_type {};
+template <typename Owner, typename U>
+struct resettable<Owner, U,
+                  std::void_t<decltype(std::declval<Owner &>().reset(
+                      std::declval<U *>()))>> : std::true_type {};
+
+// Callees taking views, binding them touches no count
+void show(eds::borrowed<MyClass> view) { view->displayData(); }
+eds::sharedPointer<MyClass> keep(eds::sharedRef<MyClass> view) {
+  std::cout << "Use count seen by the callee: " << view.use_count() << std::endl;
+  return view.share();
+}
+
+// Graph node whose edges the cycle collector can see
+struct graphNode : eds::traceable<> {
+  explicit graphNode(int id) : id(id) {}
+  ~graphNode() override { ++destroyed; }
+  void trace(eds::cycleTracer<> &tracer) override {
+    tracer(next);
+    tracer(payload);
+  }
+  int id;
+  eds::sharedPointer<graphNode> next;
+  eds::sharedPointer<MyClass> payload;
+  static inline int destroyed = 0;
+};
+
 int main() {
   std::cout << "*********************************************************"
             << std::endl;
@@ -370,6 +512,21 @@ int main() {
   ptr7->displayData();
   std::cout << "Counter for Pointer 4: " << ptr4.use_count() << std::endl;
   std::cout << "Counter for Pointer 7: " << ptr7.use_count() << std::endl;
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Testing the control block layout (two words per pointer)" << std::endl;
+  std::cout << "sizeof(eds::sharedPointer<MyClass>): " << sizeof(eds::sharedPointer<MyClass>)
+            << ", two pointers: " << std::boolalpha
+            << (sizeof(eds::sharedPointer<MyClass>) == 2 * sizeof(void *)) << std::endl;
+  {
+    eds::sharedPointer<MyClass> inlinePtr = eds::make_shared<MyClass>(8);
+    eds::weakPointer<MyClass> inlineWeak(inlinePtr);
+    std::cout << "make_shared object inside its control block, Counter: "
+              << inlinePtr.use_count() << std::endl;
+    std::cout << "Dropping the last owner while a weakPointer still watches:" << std::endl;
+    inlinePtr.reset();
+    std::cout << "Is the weak pointer expired? " << inlineWeak.expired() << std::endl;
+  }
   std::cout << "--------------------------------------------------------------------------------------------------------------"
             << std::endl;
   std::cout << "*********************************************************"
@@ -475,6 +632,1321 @@ int main() {
   anotherWeakPtr.reset();
   std::cout << "anotherWeakPtr use count: " << anotherWeakPtr.use_count()
             << " is it expired? " << anotherWeakPtr.expired() << std::endl;
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tAtomic counting testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Four threads copying and dropping one eds::sharedPointer<int, eds::atomicCount>"
+            << std::endl;
+  {
+    eds::sharedPointer<int, eds::atomicCount> atomicPtr =
+        eds::make_shared<int, eds::atomicCount>(5);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&atomicPtr] {
+        for (int i = 0; i < 100000; ++i) {
+          eds::sharedPointer<int, eds::atomicCount> copy(atomicPtr);
+        }
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    std::cout << "Counter after all threads finished: " << atomicPtr.use_count()
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Threads locking a weakPointer while the last owner goes away" << std::endl;
+  {
+    std::atomic<int> revived{0};
+    for (int round = 0; round < 200; ++round) {
+      eds::sharedPointer<int, eds::atomicCount> owner =
+          eds::make_shared<int, eds::atomicCount>(round);
+      eds::weakPointer<int, eds::atomicCount> watcher(owner);
+      std::thread locker([watcher, &revived] {
+        for (int i = 0; i < 1000; ++i) {
+          eds::sharedPointer<int, eds::atomicCount> locked = watcher.lock();
+          // Once expired, lock must never hand out the object again
+          if (!locked && watcher.lock()) {
+            ++revived;
+          }
+        }
+      });
+      owner.reset();
+      locker.join();
+    }
+    std::cout << "Objects revived after expiring: " << revived << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tBiased counting testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Copies on the owner thread only touch the biased counter" << std::endl;
+  {
+    eds::sharedPointer<MyClass, eds::biasedCount> biasedPtr =
+        eds::make_shared<MyClass, eds::biasedCount>(11);
+    eds::sharedPointer<MyClass, eds::biasedCount> biasedCopy(biasedPtr);
+    std::cout << "Counter on the owner thread: " << biasedPtr.use_count() << std::endl;
+    std::cout << "Handing both references to a worker thread that drops them" << std::endl;
+    std::thread worker(
+        [](eds::sharedPointer<MyClass, eds::biasedCount> first,
+           eds::sharedPointer<MyClass, eds::biasedCount> second) {
+          first.reset();
+          second.reset();
+        },
+        std::move(biasedPtr), std::move(biasedCopy));
+    worker.join();
+    std::cout << "The owner merges the queued object:" << std::endl;
+    eds::biased_merge_pending();
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Workers copying an object owned by the main thread" << std::endl;
+  {
+    eds::sharedPointer<int, eds::biasedCount> biasedInt =
+        eds::make_shared<int, eds::biasedCount>(12);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; ++t) {
+      workers.emplace_back([&biasedInt] {
+        for (int i = 0; i < 100000; ++i) {
+          eds::sharedPointer<int, eds::biasedCount> copy(biasedInt);
+        }
+      });
+    }
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    std::cout << "Counter after all threads finished: " << biasedInt.use_count()
+              << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tAtomic sharedPointer slot testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Stress test: 4 readers loading while 2 writers store and compare_exchange"
+            << std::endl;
+  {
+    using version = std::pair<int, int>; // second is always twice the first
+    eds::atomicSharedPointer<version> slot(
+        eds::make_shared<version, eds::atomicCount>(0, 0));
+    std::atomic<bool> done{false};
+    std::atomic<long> loads{0};
+    std::atomic<long> broken{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+      readers.emplace_back([&] {
+        while (!done.load()) {
+          eds::sharedPointer<version, eds::atomicCount> snapshot = slot.load();
+          if (!snapshot || snapshot->second != 2 * snapshot->first) {
+            ++broken;
+          }
+          ++loads;
+        }
+      });
+    }
+    std::vector<std::thread> writers;
+    std::atomic<int> swapped{0};
+    for (int t = 0; t < 2; ++t) {
+      writers.emplace_back([&, t] {
+        for (int i = 1; i <= 20000; ++i) {
+          if (t == 0) {
+            slot.store(eds::make_shared<version, eds::atomicCount>(i, 2 * i));
+          } else {
+            eds::sharedPointer<version, eds::atomicCount> expected = slot.load();
+            if (slot.compare_exchange_strong(
+                    expected, eds::make_shared<version, eds::atomicCount>(-i, -2 * i))) {
+              ++swapped;
+            }
+          }
+        }
+      });
+    }
+    for (std::thread &writer : writers) {
+      writer.join();
+    }
+    done = true;
+    for (std::thread &reader : readers) {
+      reader.join();
+    }
+    std::cout << "Some loads done: " << (loads > 0) << ", some compare_exchanges won: "
+              << (swapped > 0) << std::endl;
+    std::cout << "Torn or empty snapshots: " << broken << std::endl;
+    std::cout << "Counter of the last stored value: " << slot.load().use_count()
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Atomic weakPointer slot does not keep the object alive" << std::endl;
+  {
+    eds::sharedPointer<MyClass, eds::atomicCount> owner =
+        eds::make_shared<MyClass, eds::atomicCount>(13);
+    eds::atomicWeakPointer<MyClass> weakSlot;
+    weakSlot.store(owner);
+    std::cout << "Locked from the slot: ";
+    weakSlot.load().lock()->displayData();
+    owner.reset();
+    std::cout << "Expired after the owner is gone? " << weakSlot.load().expired()
+              << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tCustom deleter testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "uniquePointer with a stateless deleter calling std::free" << std::endl;
+  {
+    eds::uniquePointer<int, freeDeleter> mallocPtr(
+        static_cast<int *>(std::malloc(sizeof(int))));
+    *mallocPtr = 21;
+    std::cout << "Value: " << *mallocPtr << ", sizeof is one pointer: "
+              << (sizeof(mallocPtr) == sizeof(int *)) << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "uniquePointer owning a file descriptor through D::pointer" << std::endl;
+  {
+    eds::uniquePointer<int, descriptorDeleter> descriptor(descriptorHandle{3});
+    std::cout << "Owns descriptor: " << descriptor.get().fd << std::endl;
+    descriptor.reset();
+    std::cout << "After reset, is it empty? " << !descriptor << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "sharedPointer with a stateful deleter stored in the control block" << std::endl;
+  {
+    int deleted = 0;
+    {
+      eds::sharedPointer<MyClass> withDeleter(new MyClass(22), [&deleted](MyClass *ptr) {
+        ++deleted;
+        delete ptr;
+      });
+      eds::sharedPointer<MyClass> copy = withDeleter;
+      std::cout << "sizeof(sharedPointer) unchanged: "
+                << (sizeof(withDeleter) == 2 * sizeof(void *)) << std::endl;
+    }
+    std::cout << "Deleter calls after the last owner: " << deleted << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tAliasing and shared_from_this testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Aliasing constructor keeps the outer object alive" << std::endl;
+  {
+    eds::sharedPointer<MyClass> memberPtr;
+    {
+      eds::sharedPointer<outerClass> outer = eds::make_shared<outerClass>(32);
+      memberPtr = eds::sharedPointer<MyClass>(outer, &outer->member);
+      std::cout << "Use count shared with the outer object: " << outer.use_count()
+                << std::endl;
+    }
+    std::cout << "Outer pointer gone, member still there: ";
+    memberPtr->displayData();
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "shared_from_this shares the existing control block" << std::endl;
+  {
+    eds::sharedPointer<selfAware> fromMake = eds::make_shared<selfAware>(33);
+    eds::sharedPointer<selfAware> self = fromMake->self();
+    std::cout << "make_shared owner, use count: " << fromMake.use_count()
+              << ", same object: " << (self.get() == fromMake.get()) << std::endl;
+    eds::sharedPointer<selfAware> fromRaw(new selfAware(34));
+    std::cout << "sharedPointer(T*) owner, use count: "
+              << fromRaw->self().use_count() << std::endl;
+    selfAware unowned(35);
+    std::cout << "Without an owner it is empty: " << !unowned.self() << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tArray testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "uniquePointer<T[]> calls delete[] on its elements" << std::endl;
+  {
+    eds::uniquePointer<MyClass[]> objects(new MyClass[2]{36, 37});
+    objects[1].displayData();
+    std::cout << "Takes a derived array: "
+              << std::is_constructible<eds::uniquePointer<strategy[]>,
+                                       addStrategy *>::value
+              << ", resets to one: "
+              << resettable<eds::uniquePointer<strategy[]>, addStrategy>::value
+              << std::endl;
+    std::cout << "sharedPointer<T[]> takes a derived array: "
+              << std::is_constructible<eds::sharedPointer<strategy[]>,
+                                       addStrategy *>::value
+              << ", with a deleter: "
+              << std::is_constructible<eds::sharedPointer<strategy[]>,
+                                       addStrategy *,
+                                       eds::defaultDelete<strategy[]>>::value
+              << ", resets to one: "
+              << resettable<eds::sharedPointer<strategy[]>, addStrategy>::value
+              << ", takes its own: "
+              << std::is_constructible<eds::sharedPointer<strategy[]>,
+                                       strategy *>::value
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "make_unique<T[]> value-initializes, make_unique_for_overwrite does not" << std::endl;
+  {
+    eds::uniquePointer<int[]> zeroed = eds::make_unique<int[]>(4);
+    std::cout << "Zeroed elements: " << zeroed[0] << zeroed[1] << zeroed[2]
+              << zeroed[3] << std::endl;
+    eds::uniquePointer<int[]> buffer = eds::make_unique_for_overwrite<int[]>(1024);
+    for (int i = 0; i < 1024; ++i) {
+      buffer[i] = i;
+    }
+    std::cout << "Overwritten buffer, last element: " << buffer[1023] << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "sharedPointer<T[]> from new[] and from make_shared<T[]>" << std::endl;
+  {
+    eds::sharedPointer<MyClass[]> objects(new MyClass[2]{38, 39});
+    eds::sharedPointer<MyClass[]> copy = objects;
+    copy[0].displayData();
+    eds::sharedPointer<int[]> numbers = eds::make_shared<int[]>(3);
+    eds::weakPointer<int[]> observer = numbers;
+    numbers[2] = 40;
+    std::cout << "Elements: " << numbers[0] << numbers[1] << " " << observer.lock()[2]
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "make_shared<T[]> is a single allocation" << std::endl;
+  {
+    std::pmr::monotonic_buffer_resource arena;
+    countingResource counting(&arena);
+    std::pmr::polymorphic_allocator<char> alloc(&counting);
+    {
+      eds::sharedPointer<double[]> samples =
+          eds::allocate_shared_for_overwrite<double[]>(alloc, 100000);
+      samples[99999] = 41;
+      std::cout << "Allocations for 100000 elements: " << counting.allocations
+                << ", last element: " << samples[99999] << std::endl;
+    }
+    std::cout << "Given back to the arena: " << counting.deallocations << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tAllocator testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "allocate_shared out of a per-request monotonic arena" << std::endl;
+  {
+    std::pmr::monotonic_buffer_resource arena;
+    countingResource counting(&arena);
+    std::pmr::polymorphic_allocator<MyClass> alloc(&counting);
+    {
+      eds::sharedPointer<MyClass> fromArena = eds::allocate_shared<MyClass>(alloc, 23);
+      eds::sharedPointer<MyClass> copy = fromArena;
+      copy->displayData();
+      std::cout << "Allocations from the arena: " << counting.allocations << std::endl;
+    }
+    std::cout << "Given back to the arena: " << counting.deallocations << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "The allocator reaches allocator-aware objects too" << std::endl;
+  {
+    std::pmr::monotonic_buffer_resource arena;
+    countingResource counting(&arena);
+    std::pmr::polymorphic_allocator<int> alloc(&counting);
+    auto numbers = eds::allocate_shared<std::pmr::vector<int>>(alloc);
+    numbers->push_back(24);
+    std::cout << "Vector uses the arena: "
+              << (numbers->get_allocator().resource() == &counting)
+              << ", allocations: " << counting.allocations << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "sharedPointer adopting a pointer with its control block in the arena" << std::endl;
+  {
+    std::pmr::monotonic_buffer_resource arena;
+    countingResource counting(&arena);
+    {
+      eds::sharedPointer<MyClass> adopted(new MyClass(25), eds::defaultDelete<MyClass>(),
+                                          std::pmr::polymorphic_allocator<char>(&counting));
+      std::cout << "Control blocks from the arena: " << counting.allocations << std::endl;
+    }
+    std::cout << "Given back to the arena: " << counting.deallocations << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Pooled control blocks are reused on the same thread" << std::endl;
+  {
+    eds::pooledAllocator<MyClass> pooled;
+    void *first = nullptr;
+    {
+      eds::sharedPointer<MyClass> pooledPtr = eds::allocate_shared<MyClass>(pooled, 26);
+      first = pooledPtr.get();
+    }
+    eds::sharedPointer<MyClass> again = eds::allocate_shared<MyClass>(pooled, 27);
+    std::cout << "Same block as before: " << (again.get() == first) << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Pooled control blocks released on another thread" << std::endl;
+  {
+    eds::pooledAllocator<int> pooled;
+    std::vector<eds::sharedPointer<int, eds::atomicCount>> handed;
+    for (int i = 0; i < 1000; ++i) {
+      handed.push_back(eds::allocate_shared<int, eds::atomicCount>(pooled, i));
+    }
+    void *last = handed.back().get();
+    std::thread worker([&handed] { handed.clear(); });
+    worker.join();
+    // The remote frees come back to this thread once its local list is empty
+    bool reused = false;
+    std::vector<eds::sharedPointer<int, eds::atomicCount>> again;
+    for (int i = 0; i < 1000 && !reused; ++i) {
+      again.push_back(eds::allocate_shared<int, eds::atomicCount>(pooled, i));
+      reused = again.back().get() == last;
+    }
+    std::cout << "Blocks freed remotely were reused: " << reused << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tIntrusive pointer testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "intrusivePointer copies share the embedded count" << std::endl;
+  {
+    eds::intrusivePointer<countedClass> first = eds::make_intrusive<countedClass>(28);
+    eds::intrusivePointer<countedClass> second = first;
+    std::cout << "Use count: " << first->use_count()
+              << ", sizeof is one pointer: " << (sizeof(first) == sizeof(void *))
+              << std::endl;
+    // A raw pointer can be turned back into an owner at any time
+    eds::intrusivePointer<countedClass> fromRaw(second.get());
+    std::cout << "Use count after adopting the raw pointer: " << first->use_count()
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Atomic embedded count, copies dropped on several threads" << std::endl;
+  {
+    eds::intrusivePointer<countedClass> shared = eds::make_intrusive<countedClass>(29);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([shared] {
+        for (int i = 0; i < 10000; ++i) {
+          eds::intrusivePointer<countedClass> copy = shared;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::cout << "Use count after the threads: " << shared->use_count() << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Conversions between intrusivePointer and sharedPointer" << std::endl;
+  {
+    eds::intrusivePointer<countedClass> intrusive = eds::make_intrusive<countedClass>(30);
+    eds::sharedPointer<countedClass> shared = eds::to_shared(intrusive);
+    std::cout << "Embedded count with the sharedPointer: " << intrusive->use_count()
+              << std::endl;
+    intrusive.reset();
+    eds::intrusivePointer<countedClass> back = eds::from_shared(shared);
+    std::cout << "Back from the sharedPointer: " << static_cast<bool>(back)
+              << ", data: " << back->data << std::endl;
+    eds::sharedPointer<countedClass> plain(new countedClass(31));
+    std::cout << "From a plain sharedPointer is empty: " << !eds::from_shared(plain)
+              << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tInstrumentation testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Counters for sharedPointer<MyClass> since the last reset" << std::endl;
+  {
+    eds::instrumentation::reset();
+    eds::sharedPointer<MyClass> counted = eds::make_shared<MyClass>(42);
+    eds::sharedPointer<MyClass> copy = counted;
+    eds::sharedPointer<MyClass> moved = std::move(copy);
+    // Handles owning nothing are not counted, so the totals balance
+    eds::sharedPointer<MyClass> empty;
+    eds::sharedPointer<MyClass> emptyCopy = empty;
+    eds::sharedPointer<MyClass> emptyMoved = std::move(emptyCopy);
+    eds::weakPointer<MyClass> observer = counted;
+    observer.lock()->displayData();
+    // Dropped on another thread, its counts show up in the snapshot too
+    std::thread([&moved] { moved.reset(); }).join();
+    counted.reset();
+    std::cout << "Locked after the last owner: " << static_cast<bool>(observer.lock())
+              << std::endl;
+    for (const eds::typeCounters &entry : eds::instrumentation::snapshot()) {
+      if (std::strcmp(entry.type, typeid(MyClass).name()) == 0) {
+        std::cout << "constructions " << entry.counters.constructions
+                  << ", copies " << entry.counters.copies << ", moves "
+                  << entry.counters.moves << ", destructions "
+                  << entry.counters.destructions << ", lock successes "
+                  << entry.counters.lock_successes << ", lock failures "
+                  << entry.counters.lock_failures << ", block allocations "
+                  << entry.counters.block_allocations << std::endl;
+      }
+    }
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tDeferred destruction testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Last owners hand their objects to a reclaimQueue, drain() destroys them"
+            << std::endl;
+  {
+    eds::reclaimQueue queue(8);
+    eds::uniquePointer<MyClass, eds::deferredDelete<MyClass>> unique(
+        new MyClass(43), eds::deferredDelete<MyClass>(queue));
+    eds::sharedPointer<MyClass> shared(new MyClass(44),
+                                       eds::deferredDelete<MyClass>(queue));
+    unique.reset();
+    shared.reset();
+    std::cout << "Queued after the resets: " << queue.size() << std::endl;
+    std::cout << "Draining one" << std::endl;
+    queue.drain(1);
+    std::cout << "Draining the rest" << std::endl;
+    std::size_t destroyed = queue.drain();
+    std::cout << "Destroyed: " << destroyed << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "A full queue with overflow::destroy_inline destroys on the spot"
+            << std::endl;
+  {
+    eds::reclaimQueue queue(2, eds::reclaimQueue::overflow::destroy_inline);
+    for (int i = 45; i < 48; ++i) {
+      eds::uniquePointer<MyClass, eds::deferredDelete<MyClass>> dropped(
+          new MyClass(i), eds::deferredDelete<MyClass>(queue));
+    }
+    std::cout << "Queued: " << queue.size() << " of " << queue.capacity()
+              << ", the queue drains the rest when it goes away" << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "overflow::spill keeps what does not fit beside the ring" << std::endl;
+  {
+    eds::reclaimQueue queue(2, eds::reclaimQueue::overflow::spill);
+    for (int i = 0; i < 5; ++i) {
+      eds::uniquePointer<int, eds::deferredDelete<int>> dropped(
+          new int(i), eds::deferredDelete<int>(queue));
+    }
+    std::cout << "Queued: " << queue.size() << " of " << queue.capacity();
+    std::size_t drained = queue.drain();
+    std::cout << ", drained: " << drained << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "backgroundReclaimer draining for threads that wait on a full queue"
+            << std::endl;
+  {
+    static std::atomic<int> destroyed{0};
+    struct node {
+      ~node() { destroyed.fetch_add(1, std::memory_order_relaxed); }
+    };
+    eds::reclaimQueue queue(16, eds::reclaimQueue::overflow::wait);
+    {
+      eds::backgroundReclaimer reclaimer(queue, std::chrono::microseconds(50));
+      std::vector<std::thread> threads;
+      for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&queue] {
+          for (int i = 0; i < 1000; ++i) {
+            eds::sharedPointer<node, eds::atomicCount> dropped(
+                new node, eds::deferredDelete<node>(queue));
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+    }
+    std::cout << "Destroyed: " << destroyed.load() << ", still queued: "
+              << queue.size() << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Destructors run by drain() retire their children into the full queue"
+            << std::endl;
+  {
+    static int destroyed = 0;
+    struct child {
+      ~child() { ++destroyed; }
+    };
+    struct root {
+      explicit root(eds::reclaimQueue &queue) {
+        for (auto &each : children) {
+          each = eds::uniquePointer<child, eds::deferredDelete<child>>(
+              new child, eds::deferredDelete<child>(queue));
+        }
+      }
+      ~root() { ++destroyed; }
+      eds::uniquePointer<child, eds::deferredDelete<child>> children[3];
+    };
+    // Even the waiting policy spills when the drainer itself retires
+    eds::reclaimQueue queue(4, eds::reclaimQueue::overflow::wait);
+    for (int i = 0; i < 4; ++i) {
+      eds::uniquePointer<root, eds::deferredDelete<root>> dropped(
+          new root(queue), eds::deferredDelete<root>(queue));
+    }
+    std::cout << "Queued roots: " << queue.size() << " of " << queue.capacity()
+              << std::endl;
+    std::size_t drained = queue.drain();
+    std::cout << "Drained: " << drained << ", destroyed: " << destroyed
+              << ", left: " << queue.size() << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tEpoch-based reclamation testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "A retired sharedPointer outlives the guard that can still see it"
+            << std::endl;
+  {
+    eds::sharedPointer<MyClass> current = eds::make_shared<MyClass>(48);
+    {
+      eds::epochGuard guard;
+      MyClass *seen = current.get();
+      eds::epochDomain::retire(std::move(current));
+      eds::epochDomain::collect();
+      eds::epochDomain::collect();
+      std::cout << "Pending inside the guard: " << eds::epochDomain::pending()
+                << ", still readable: ";
+      seen->displayData();
+    }
+    std::cout << "Guard closed, synchronizing" << std::endl;
+    eds::epochDomain::synchronize();
+    std::cout << "Pending: " << eds::epochDomain::pending() << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Readers follow a raw pointer while a writer keeps replacing it"
+            << std::endl;
+  {
+    static std::atomic<int> destroyed{0};
+    struct node {
+      explicit node(int value) : value(value), check(value) {}
+      ~node() {
+        check = -1;
+        destroyed.fetch_add(1, std::memory_order_relaxed);
+      }
+      int value;
+      int check;
+    };
+    std::atomic<node *> published{new node(0)};
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+      readers.emplace_back([&] {
+        while (!done.load(std::memory_order_acquire)) {
+          eds::epochGuard guard;
+          node *seen = published.load(std::memory_order_acquire);
+          if (seen->check != seen->value) {
+            torn.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      });
+    }
+    std::thread writer([&] {
+      for (int i = 1; i <= 2000; ++i) {
+        node *old = published.exchange(new node(i), std::memory_order_acq_rel);
+        eds::epochDomain::retire(old);
+      }
+    });
+    writer.join();
+    done.store(true, std::memory_order_release);
+    for (auto &reader : readers) {
+      reader.join();
+    }
+    eds::epochDomain::retire(published.load());
+    // Picks up what the writer left behind when it exited
+    eds::epochDomain::synchronize();
+    std::cout << "Readers saw a destroyed node: " << torn.load()
+              << ", nodes destroyed: " << destroyed.load() << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tShared batch testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "make_shared_batch builds the objects together, a handle keeps them all"
+            << std::endl;
+  {
+    eds::sharedPointer<MyClass> kept;
+    {
+      eds::sharedBatch<MyClass> batch = eds::make_shared_batch<MyClass>(3, 49);
+      kept = batch.handle(1);
+      std::cout << "Batch of " << batch.size() << ", contiguous: "
+                << (&batch[2] - &batch[0] == 2)
+                << ", use count: " << kept.use_count() << std::endl;
+    }
+    std::cout << "Batch dropped, the handle still reads: ";
+    kept->displayData();
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "One allocation per batch, iterated like an array" << std::endl;
+  {
+    std::pmr::monotonic_buffer_resource arena;
+    countingResource counting(&arena);
+    std::pmr::polymorphic_allocator<int> alloc(&counting);
+    {
+      eds::sharedBatch<int> batch = eds::allocate_shared_batch<int>(alloc, 1000, 7);
+      int sum = 0;
+      for (int value : batch) {
+        sum += value;
+      }
+      std::cout << "Allocations for 1000 objects: " << counting.allocations
+                << ", sum: " << sum << std::endl;
+    }
+    std::cout << "Given back to the arena: " << counting.deallocations << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "shared_from_this of a batch element" << std::endl;
+  {
+    eds::sharedBatch<selfAware> batch = eds::make_shared_batch<selfAware>(4, 50);
+    eds::sharedPointer<selfAware> self = batch[2].self();
+    std::cout << "Points at its element: " << (self.get() == &batch[2])
+              << ", shares the batch block: " << (self.use_count() == 2)
+              << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tLocal shared pointer testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "localSharedPointer is one pointer wide"
+            << std::endl;
+  {
+    eds::localSharedPointer<MyClass> first = eds::make_local_shared<MyClass>(51);
+    eds::localSharedPointer<MyClass> second = first;
+    std::cout << "sizeof is one pointer: "
+              << (sizeof(first) == sizeof(void *))
+              << ", use count: " << second.use_count() << std::endl;
+    second->displayData();
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "localWeakPointer expires with the last owner" << std::endl;
+  {
+    eds::localWeakPointer<MyClass> observer;
+    {
+      eds::localSharedPointer<MyClass> owner = eds::make_local_shared<MyClass>(52);
+      observer = owner;
+      eds::localWeakPointer<MyClass> second = observer;
+      bool locked = static_cast<bool>(observer.lock());
+      std::cout << "Locked while owned: " << locked << ", weak use count: " << observer.use_count()
+                << ", owners: " << owner.use_count() << std::endl;
+    }
+    std::cout << "Expired: " << observer.expired()
+              << ", locked: " << static_cast<bool>(observer.lock()) << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tCompressed pointer testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  struct graphTag {};
+  using graphArena = eds::offsetArena<graphTag>;
+  alignas(std::max_align_t) static char region[1 << 16];
+  graphArena::attach(region, sizeof(region));
+  std::cout << "compressedUniquePointer owns an arena object in 32 bits" << std::endl;
+  {
+    eds::compressedUniquePointer<MyClass, graphArena> edge =
+        eds::make_compressed_unique<MyClass, graphArena>(53);
+    std::cout << "sizeof: " << sizeof(edge) << ", offset: " << edge.get().offset()
+              << ", data: ";
+    edge->displayData();
+    // Non-owning copies are 4 bytes as well
+    eds::compressedPointer<MyClass, graphArena> view = edge.get();
+    (*view).displayData();
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Edges of a small graph, decoded while traversing" << std::endl;
+  {
+    std::vector<eds::compressedPointer<int, graphArena>> edges;
+    for (int i = 0; i < 1000; ++i) {
+      int *node = ::new (graphArena::allocate(sizeof(int), alignof(int))) int(i);
+      edges.emplace_back(node);
+    }
+    long sum = 0;
+    for (eds::compressedPointer<int, graphArena> each : edges) {
+      sum += *each;
+    }
+    int outside = 0;
+    std::cout << "Bytes per edge: " << sizeof(edges[0]) << ", sum: " << sum
+              << ", outside the arena representable: "
+              << eds::compressedPointer<int, graphArena>::representable(&outside)
+              << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tInline unique pointer testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Small strategies live inside the pointer, big ones on the heap"
+            << std::endl;
+  {
+    eds::inlineUniquePointer<strategy> small =
+        eds::make_inline_unique<strategy, addStrategy>(5);
+    eds::inlineUniquePointer<strategy> big =
+        eds::make_inline_unique<strategy, tableStrategy>(3);
+    std::cout << "addStrategy inline: " << small.is_inline()
+              << ", apply(10): " << small->apply(10) << std::endl;
+    std::cout << "tableStrategy inline: " << big.is_inline()
+              << ", apply(10): " << big->apply(10) << std::endl;
+    small.swap(big);
+    std::cout << "Swapped, apply(10): " << small->apply(10) << " and "
+              << big->apply(10) << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Inline objects are relocated when the pointer moves" << std::endl;
+  {
+    std::vector<eds::inlineUniquePointer<strategy>> strategies;
+    for (int i = 0; i < 100; ++i) {
+      // The vector grows, every inline object gets moved to its new slot
+      strategies.push_back(eds::make_inline_unique<strategy, addStrategy>(i));
+    }
+    int total = 0;
+    for (const auto &each : strategies) {
+      total += each->apply(0);
+    }
+    std::cout << "Sum after reallocations: " << total << std::endl;
+    eds::uniquePointer<strategy> released(strategies[7].release());
+    std::cout << "Released to the heap, apply(0): " << released->apply(0)
+              << ", left empty: " << !strategies[7] << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tBorrowed views and pointer casts testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Views bind to owners without count traffic" << std::endl;
+  {
+    eds::sharedPointer<MyClass> owner = eds::make_shared<MyClass>(54);
+    eds::uniquePointer<MyClass> unique = eds::make_unique<MyClass>(55);
+    show(owner);
+    show(unique);
+    eds::sharedPointer<MyClass> kept = keep(owner);
+    std::cout << "Use count after share(): " << owner.use_count()
+              << ", sizeof borrowed is one pointer: "
+              << (sizeof(eds::borrowed<MyClass>) == sizeof(void *)) << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Casts of rvalues take the reference over" << std::endl;
+  {
+    eds::sharedPointer<strategy> base =
+        eds::static_pointer_cast<strategy>(eds::make_shared<addStrategy>(6));
+    eds::sharedPointer<tableStrategy> wrong =
+        eds::dynamic_pointer_cast<tableStrategy>(std::move(base));
+    std::cout << "Failed dynamic cast is empty: " << !wrong
+              << ", source kept: " << static_cast<bool>(base) << std::endl;
+    eds::sharedPointer<addStrategy> right =
+        eds::dynamic_pointer_cast<addStrategy>(std::move(base));
+    std::cout << "Cast moved, source empty: " << !base
+              << ", use count: " << right.use_count()
+              << ", apply(1): " << right->apply(1) << std::endl;
+    eds::sharedPointer<const addStrategy> readOnly =
+        eds::static_pointer_cast<const addStrategy>(right);
+    eds::sharedPointer<addStrategy> writable =
+        eds::const_pointer_cast<addStrategy>(readOnly);
+    std::cout << "Copied casts share the count: " << right.use_count() << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tCopy-on-write testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Snapshots share, the first write to a shared object clones it"
+            << std::endl;
+  {
+    eds::cowPointer<MyClass> document = eds::make_cow<MyClass>(56);
+    eds::cowPointer<MyClass> snapshot = document;
+    std::cout << "Use count after the snapshot: " << document.use_count()
+              << std::endl;
+    std::cout << "Writing to the shared document" << std::endl;
+    document.write() = MyClass(57);
+    std::cout << "Snapshot: ";
+    snapshot->displayData();
+    std::cout << "Writing again, nobody else shares it now" << std::endl;
+    document.write().displayData();
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Writers on several threads with atomicCount" << std::endl;
+  {
+    eds::cowPointer<std::vector<int>, eds::atomicCount> original =
+        eds::make_cow<std::vector<int>, eds::atomicCount>(1000, 1);
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([original, t, &wrong]() mutable {
+        for (int i = 0; i < 100; ++i) {
+          eds::cowPointer<std::vector<int>, eds::atomicCount> edit = original;
+          edit.write()[0] = t;
+          if ((*edit)[0] != t) {
+            wrong.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+        // Last copy of this thread, written in place once the others let go
+        original.write()[1] = t;
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::cout << "Lost writes: " << wrong.load() << ", original untouched: "
+              << ((*original)[0] == 1 && (*original)[1] == 1) << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "unique() stays exact while another thread locks and drops weak observers"
+            << std::endl;
+  {
+    eds::sharedPointer<int, eds::atomicCount> owner =
+        eds::make_shared<int, eds::atomicCount>(0);
+    eds::weakPointer<int, eds::atomicCount> observer = owner;
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::thread reader([observer, &stop, &torn]() mutable {
+      while (!stop.load(std::memory_order_relaxed)) {
+        eds::sharedPointer<int, eds::atomicCount> locked = observer.lock();
+        // Only the strong reference is left, the weak one comes back after
+        observer.reset();
+        if (*locked != 0) {
+          torn.fetch_add(1, std::memory_order_relaxed);
+        }
+        observer = locked;
+      }
+    });
+    observer.reset();
+    for (int i = 0; i < 20000; ++i) {
+      if (owner.unique()) {
+        // Nobody else can see the object while it is odd
+        *owner = 1;
+        *owner = 0;
+      }
+    }
+    stop.store(true, std::memory_order_relaxed);
+    reader.join();
+    std::cout << "Reader saw a write in progress: " << torn.load() << " times"
+              << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tWeak value cache testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Values live as long as somebody uses them" << std::endl;
+  {
+    eds::weakValueCache<int, MyClass> cache;
+    auto build = [] { return eds::make_shared<MyClass, eds::atomicCount>(58); };
+    eds::sharedPointer<MyClass, eds::atomicCount> first = cache.get_or_create(7, build);
+    eds::sharedPointer<MyClass, eds::atomicCount> second = cache.get_or_create(7, build);
+    std::cout << "Same object on the hit: " << (first.get() == second.get())
+              << std::endl;
+    first.reset();
+    second.reset();
+    std::cout << "Found after the last user: " << static_cast<bool>(cache.find(7))
+              << ", purged: " << cache.purge() << ", size: " << cache.size()
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Concurrent misses on one key build the value once" << std::endl;
+  {
+    eds::weakValueCache<int, int> cache;
+    std::atomic<int> builds{0};
+    std::vector<eds::sharedPointer<int, eds::atomicCount>> results(8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+      threads.emplace_back([&cache, &builds, &results, t] {
+        results[t] = cache.get_or_create(42, [&builds] {
+          builds.fetch_add(1, std::memory_order_relaxed);
+          std::this_thread::sleep_for(std::chrono::milliseconds(20));
+          return eds::make_shared<int, eds::atomicCount>(42);
+        });
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    bool same = true;
+    for (const auto &result : results) {
+      same = same && result.get() == results[0].get();
+    }
+    std::cout << "Factory runs: " << builds.load() << ", all got the same value: "
+              << same << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Expired entries are swept a few buckets per operation" << std::endl;
+  {
+    eds::weakValueCache<int, int> cache;
+    for (int key = 0; key < 1000; ++key) {
+      // Dropped right away, the entry expires
+      cache.get_or_create(key, [key] { return eds::make_shared<int, eds::atomicCount>(key); });
+    }
+    std::size_t before = cache.size();
+    for (int key = 0; key < 1000; ++key) {
+      cache.find(key + 1000);
+    }
+    std::cout << "Entries before the lookups: " << before
+              << ", after: " << cache.size() << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tObject pool testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Released objects come back reset" << std::endl;
+  {
+    int resets = 0;
+    eds::objectPool<std::vector<int>> pool(
+        16, [&resets](std::vector<int> &buffer) {
+          buffer.clear();
+          ++resets;
+        });
+    std::vector<int> *first = nullptr;
+    {
+      auto buffer = pool.acquire_unique();
+      buffer->assign(100, 7);
+      first = buffer.get();
+    }
+    auto again = pool.acquire_unique();
+    std::cout << "Same object: " << (again.get() == first)
+              << ", empty: " << again->empty()
+              << ", capacity kept: " << (again->capacity() >= 100)
+              << ", resets: " << resets << std::endl;
+    eds::sharedPointer<std::vector<int>> shared = pool.acquire_shared();
+    eds::sharedPointer<std::vector<int>> copy = shared;
+    shared.reset();
+    std::cout << "Resets with one shared owner left: " << resets;
+    copy.reset();
+    std::cout << ", with none: " << resets << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Idle objects beyond the capacity are deleted" << std::endl;
+  {
+    eds::objectPool<int> pool(2);
+    std::vector<eds::uniquePointer<int, eds::poolDeleter<int>>> handles;
+    for (std::size_t i = 0; i < eds::objectPoolBase::localCapacity + 4; ++i) {
+      handles.push_back(pool.acquire_unique());
+    }
+    // The thread cache spills half of itself, the overflow keeps two
+    handles.clear();
+    std::cout << "Idle in the overflow: " << pool.idle() << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "A T without default constructor needs a factory" << std::endl;
+  {
+    struct sized {
+      explicit sized(int bytes) : bytes(bytes) {}
+      int bytes;
+    };
+    bool refused = false;
+    try {
+      eds::objectPool<sized> pool;
+    } catch (const std::invalid_argument &) {
+      refused = true;
+    }
+    eds::objectPool<sized> pool(16, nullptr, [] { return new sized(64); });
+    std::cout << "Refused without one: " << refused
+              << ", made by the factory: " << pool.acquire_unique()->bytes
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Threads acquire and release through their own caches" << std::endl;
+  {
+    std::atomic<int> created{0};
+    eds::objectPool<int> pool(64, [](int &value) { value = 0; }, [&created] {
+      created.fetch_add(1, std::memory_order_relaxed);
+      return new int(0);
+    });
+    std::atomic<int> dirty{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&pool, &dirty] {
+        for (int i = 0; i < 10000; ++i) {
+          auto value = pool.acquire_shared<eds::atomicCount>();
+          if (*value != 0) {
+            dirty.fetch_add(1, std::memory_order_relaxed);
+          }
+          *value = i + 1;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::cout << "At most one object created per thread: " << (created.load() <= 4)
+              << ", handed out unreset: " << dirty.load()
+              << ", all idle after the threads exited: "
+              << (pool.idle() == static_cast<std::size_t>(created.load()))
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "A thread outliving a pool deletes its cached objects" << std::endl;
+  {
+    // Every pooled object holds a copy of token
+    using counted = eds::sharedPointer<int, eds::atomicCount>;
+    counted token = eds::make_shared<int, eds::atomicCount>(0);
+    auto copies = [&token] { return new counted(token); };
+    auto dying = new eds::objectPool<counted>(16, nullptr, copies);
+    eds::objectPool<counted> other(16, nullptr, copies);
+    std::atomic<int> stage{0};
+    std::size_t cached = 0;
+    std::size_t left = 0;
+    std::thread worker([&] {
+      // Released here, so it stays in this thread's cache
+      dying->acquire_unique();
+      stage.store(1, std::memory_order_release);
+      while (stage.load(std::memory_order_acquire) != 2) {
+        std::this_thread::yield();
+      }
+      cached = token.use_count() - 1;
+      // The first lookup after the pool is gone drops its cache
+      other.acquire_unique();
+      left = token.use_count() - 1;
+    });
+    while (stage.load(std::memory_order_acquire) != 1) {
+      std::this_thread::yield();
+    }
+    delete dying;
+    stage.store(2, std::memory_order_release);
+    worker.join();
+    std::cout << "Objects of the dead pool before the lookup: " << cached
+              << ", after it: " << left - 1 << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tHandoff queue testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "Ownership moves through the queue in order" << std::endl;
+  {
+    eds::handoffQueue<MyClass> queue(4);
+    queue.push(eds::make_unique<MyClass>(60));
+    eds::uniquePointer<MyClass> rejected(new MyClass(61));
+    std::size_t pushed = 1;
+    while (queue.try_push(std::move(rejected))) {
+      rejected.reset(new MyClass(61));
+      ++pushed;
+    }
+    std::cout << "Capacity: " << queue.capacity() << ", pushed: " << pushed
+              << ", rejected item still owned: " << static_cast<bool>(rejected)
+              << std::endl;
+    eds::uniquePointer<MyClass> first = queue.try_pop();
+    std::cout << "First out: ";
+    first->displayData();
+    std::cout << "Left: " << queue.size() << std::endl;
+    rejected.reset();
+    // The queue deletes the rest
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Batches claim several cells at once" << std::endl;
+  {
+    eds::handoffQueue<int> queue(16);
+    eds::uniquePointer<int> in[20];
+    for (int i = 0; i < 20; ++i) {
+      in[i].reset(new int(i));
+    }
+    std::size_t pushed = queue.try_push_batch(in, 20);
+    eds::uniquePointer<int> out[8];
+    std::size_t popped = queue.try_pop_batch(out, 8);
+    std::cout << "Pushed: " << pushed << ", first unpushed still owned: "
+              << static_cast<bool>(in[pushed]) << ", popped: " << popped
+              << ", first and last popped: " << *out[0] << " " << *out[popped - 1]
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Empty items are refused" << std::endl;
+  {
+    eds::handoffQueue<int> queue(16);
+    bool accepted = queue.try_push(eds::uniquePointer<int>());
+    queue.push(eds::uniquePointer<int>());
+    eds::uniquePointer<int> in[3];
+    in[0].reset(new int(1));
+    in[2].reset(new int(3));
+    // Stops at the empty one in the middle
+    std::size_t pushed = queue.try_push_batch(in, 3);
+    std::cout << "Single push accepted: " << accepted << ", batch pushed: " << pushed
+              << ", queued: " << queue.size()
+              << ", item after the gap still owned: " << static_cast<bool>(in[2])
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Producers and consumers hand over every item exactly once" << std::endl;
+  {
+    eds::handoffQueue<int> queue(64);
+    std::atomic<long> sum{0};
+    std::atomic<int> received{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+      threads.emplace_back([&queue, t] {
+        eds::uniquePointer<int> batch[4];
+        for (int i = 0; i < 10000; i += 4) {
+          for (int j = 0; j < 4; ++j) {
+            batch[j].reset(new int(t * 10000 + i + j));
+          }
+          std::size_t done = 0;
+          while (done < 4) {
+            done += queue.try_push_batch(batch + done, 4 - done);
+          }
+        }
+      });
+      threads.emplace_back([&queue, &sum, &received] {
+        while (received.load(std::memory_order_relaxed) < 20000) {
+          if (eds::uniquePointer<int> value = queue.try_pop()) {
+            sum.fetch_add(*value, std::memory_order_relaxed);
+            received.fetch_add(1, std::memory_order_relaxed);
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::cout << "Received: " << received.load()
+              << ", sum as sent: " << (sum.load() == 19999L * 20000 / 2) << std::endl;
+  }
+  std::cout << "*********************************************************"
+            << std::endl;
+  std::cout << std::endl << "\t\tCycle collector testing" << std::endl;
+  std::cout << std::endl
+            << "*********************************************************"
+            << std::endl;
+  std::cout << "A leaked cycle is freed, a referenced one is kept" << std::endl;
+  {
+    eds::cycleCollector<> collector;
+    graphNode::destroyed = 0;
+    {
+      auto one = eds::make_shared<graphNode>(1);
+      auto two = eds::make_shared<graphNode>(2);
+      one->next = two;
+      two->next = one;
+      one->payload = eds::make_shared<MyClass>(62);
+      collector.track(one);
+    }
+    auto kept = eds::make_shared<graphNode>(3);
+    kept->next = eds::make_shared<graphNode>(4);
+    kept->next->next = kept;
+    collector.track(kept);
+    std::cout << "Before collecting, tracked: " << collector.tracked()
+              << ", destroyed: " << graphNode::destroyed << std::endl;
+    std::size_t freed = collector.collect();
+    std::cout << "Freed: " << freed << ", destroyed: " << graphNode::destroyed
+              << ", still tracked: " << collector.tracked() << std::endl;
+    kept->next.reset();
+    std::cout << "Acyclic again, destroyed: " << graphNode::destroyed
+              << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "Incremental passes while the graph keeps changing" << std::endl;
+  {
+    eds::cycleCollector<> collector;
+    graphNode::destroyed = 0;
+    // A ring of 1000 nodes reachable from root
+    auto root = eds::make_shared<graphNode>(0);
+    auto last = root;
+    for (int id = 1; id < 1000; ++id) {
+      last->next = eds::make_shared<graphNode>(id);
+      last = last->next;
+    }
+    last->next = root;
+    last.reset();
+    collector.track(root);
+    std::size_t steps = 0;
+    std::size_t freed = 0;
+    do {
+      freed += collector.collect_step(64);
+      ++steps;
+      if (steps == 3) {
+        // Found a first time now, after the scan passed it
+        root.reset();
+      }
+    } while (collector.collecting());
+    std::cout << "Steps in the first pass: " << steps << ", freed: " << freed
+              << std::endl;
+    // The first pass only saw the root tracked and still owned
+    freed = collector.collect();
+    std::cout << "Second pass freed: " << freed
+              << ", destroyed: " << graphNode::destroyed << std::endl;
+  }
+  std::cout << "--------------------------------------------------------------------------------------------------------------"
+            << std::endl;
+  std::cout << "The sweep is followed by a compaction in steps" << std::endl;
+  {
+    eds::cycleCollector<> collector;
+    graphNode::destroyed = 0;
+    // A leaked ring of 1000 nodes
+    auto first = eds::make_shared<graphNode>(0);
+    auto last = first;
+    for (int id = 1; id < 1000; ++id) {
+      last->next = eds::make_shared<graphNode>(id);
+      last = last->next;
+    }
+    last->next = first;
+    collector.track(first);
+    last.reset();
+    first.reset();
+    std::size_t freed = 0;
+    while (freed == 0) {
+      freed = collector.collect_step(64);
+    }
+    std::size_t trackedAfterSweep = collector.tracked();
+    std::size_t steps = 0;
+    while (collector.collecting()) {
+      collector.collect_step(64);
+      ++steps;
+    }
+    std::cout << "Freed: " << freed << ", destroyed: " << graphNode::destroyed
+              << ", tracked after the sweep: " << trackedAfterSweep
+              << ", compaction steps: " << steps
+              << ", tracked after them: " << collector.tracked() << std::endl;
+  }
   std::cout << "*********************************************************"
             << std::endl;
   std::cout << std::endl
@@ -1,16 +1,43 @@
 #pragma once
 
-#include <utility> // For std::move
+#include "deleter.hpp"
+#include <cstddef>     // For std::nullptr_t, std::size_t
+#include <type_traits> // For std::enable_if_t, std::decay_t, std::is_array, std::is_convertible
+#include <utility>     // For std::move
 
 namespace eds {
 
-template <typename T> class uniquePointer {
+// D is called on the owned pointer instead of delete, see deleter.hpp
+template <typename T, typename D = defaultDelete<T>> class uniquePointer {
 public:
-  explicit uniquePointer(T *ptr = nullptr);
+  // Pointer type handed to the deleter, T* unless D::pointer says otherwise
+  using pointer = typename deleterPointer<T, D>::type;
+  using element_type = T;
+  using deleter_type = D;
+
+private:
+  // True when Args are meant for T's constructor and not a pointer to adopt
+  template <typename... Args> struct constructs_object {
+    static constexpr bool value = std::is_same<D, defaultDelete<T>>::value;
+  };
+  template <typename Arg> struct constructs_object<Arg> {
+    static constexpr bool value =
+        std::is_same<D, defaultDelete<T>>::value &&
+        !std::is_convertible<Arg, pointer>::value &&
+        !std::is_same<std::decay_t<Arg>, uniquePointer>::value;
+  };
+
+public:
+  explicit uniquePointer(pointer ptr = pointer()) noexcept;
+  // Constructors taking the pointer together with the deleter to call on it
+  uniquePointer(pointer ptr, const D &deleter);
+  uniquePointer(pointer ptr, D &&deleter) noexcept;
   // Template constructor for variadic arguments, creating a new T object usingperfect forwarding
-  template <typename... Args>
+  // (only with the default deleter, and never for a lone pointer, nullptr or uniquePointer)
+  template <typename... Args,
+            typename = std::enable_if_t<constructs_object<Args...>::value>>
   uniquePointer(Args &&...args)
-      : pointer_{new T{std::forward<Args>(args)...}} {}
+      : storage_(pointer{new T{std::forward<Args>(args)...}}) {}
   // Copy constructor deleted to enforce unique ownership
   uniquePointer(const uniquePointer &other) = delete;
   // Copy assignment operator deleted to enforce unique ownership
@@ -18,73 +45,277 @@ public:
   uniquePointer(uniquePointer &&other) noexcept;
   uniquePointer &operator=(uniquePointer &&other) noexcept;
   ~uniquePointer();
-  T *get() const;
+  pointer get() const;
   T &operator*() const;
-  T *operator->() const;
+  pointer operator->() const;
   explicit operator bool() const;
-  void reset(T *ptr = nullptr);
-  T *release();
+  void reset(pointer ptr = pointer());
+  pointer release();
   void swap(uniquePointer &other);
+  // Access to the stored deleter
+  D &get_deleter() noexcept;
+  const D &get_deleter() const noexcept;
 
 private:
-  T *pointer_;
+  // The deleter sits in an empty base when it is stateless, so the whole
+  // uniquePointer is one pointer wide
+  struct storage : eboStorage<D> {
+    explicit storage(pointer ptr) : eboStorage<D>(), pointer_(ptr) {}
+    template <typename E>
+    storage(pointer ptr, E &&deleter)
+        : eboStorage<D>(std::forward<E>(deleter)), pointer_(ptr) {}
+    pointer pointer_;
+  };
+  storage storage_;
 };
 // Explicit constructor initializing the pointer with a default value ofnullptr
-template <typename T> uniquePointer<T>::uniquePointer(T *ptr) : pointer_(ptr) {}
+template <typename T, typename D>
+uniquePointer<T, D>::uniquePointer(pointer ptr) noexcept : storage_(ptr) {}
+// Constructors initializing the pointer together with its deleter
+template <typename T, typename D>
+uniquePointer<T, D>::uniquePointer(pointer ptr, const D &deleter)
+    : storage_(ptr, deleter) {}
+template <typename T, typename D>
+uniquePointer<T, D>::uniquePointer(pointer ptr, D &&deleter) noexcept
+    : storage_(ptr, std::move(deleter)) {}
 // Move constructor with noexcept specifier for optimized move semantics
-template <typename T>
-uniquePointer<T>::uniquePointer(uniquePointer &&other) noexcept
-    : pointer_(other.release()) {}
+template <typename T, typename D>
+uniquePointer<T, D>::uniquePointer(uniquePointer &&other) noexcept
+    : storage_(other.release(), std::move(other.get_deleter())) {}
 // Move assignment operator with noexcept specifier for optimized move semantics
-template <typename T>
-uniquePointer<T> &uniquePointer<T>::operator=(uniquePointer &&other) noexcept {
+template <typename T, typename D>
+uniquePointer<T, D> &
+uniquePointer<T, D>::operator=(uniquePointer &&other) noexcept {
   if (this != &other) {
     reset(other.release());
+    get_deleter() = std::move(other.get_deleter());
   }
   return *this;
 }
 // Destructor for releasing the allocated memory
-template <typename T> uniquePointer<T>::~uniquePointer() { delete pointer_; }
+template <typename T, typename D> uniquePointer<T, D>::~uniquePointer() {
+  if (storage_.pointer_ != pointer()) {
+    get_deleter()(storage_.pointer_);
+  }
+}
 // Make_unique function for creating unique pointers
 template <typename T, typename... Args>
-uniquePointer<T> make_unique(Args &&...args) {
+std::enable_if_t<!std::is_array<T>::value, uniquePointer<T>>
+make_unique(Args &&...args) {
   return uniquePointer<T>(new T(std::forward<Args>(args)...));
 }
+// Array version, size value-initialized elements
+template <typename T>
+std::enable_if_t<std::is_array<T>::value && std::extent<T>::value == 0,
+                 uniquePointer<T>>
+make_unique(std::size_t size) {
+  return uniquePointer<T>(new std::remove_extent_t<T>[size]());
+}
+// Default-initialized object, nothing gets zeroed that is overwritten anyway
+template <typename T>
+std::enable_if_t<!std::is_array<T>::value, uniquePointer<T>>
+make_unique_for_overwrite() {
+  return uniquePointer<T>(new T);
+}
+// Array version, size default-initialized elements (big I/O buffers)
+template <typename T>
+std::enable_if_t<std::is_array<T>::value && std::extent<T>::value == 0,
+                 uniquePointer<T>>
+make_unique_for_overwrite(std::size_t size) {
+  return uniquePointer<T>(new std::remove_extent_t<T>[size]);
+}
 // Getter function to retrieve the raw pointer
-template <typename T> T *uniquePointer<T>::get() const { return pointer_; }
+template <typename T, typename D>
+typename uniquePointer<T, D>::pointer uniquePointer<T, D>::get() const {
+  return storage_.pointer_;
+}
 // Overloaded dereference operator (*) for accessing the object
-template <typename T> T &uniquePointer<T>::operator*() const {
-  return *pointer_;
+template <typename T, typename D> T &uniquePointer<T, D>::operator*() const {
+  return *storage_.pointer_;
 }
 // Overloaded arrow operator (->) for accessing members of the object
-template <typename T> T *uniquePointer<T>::operator->() const {
-  return pointer_;
+template <typename T, typename D>
+typename uniquePointer<T, D>::pointer uniquePointer<T, D>::operator->() const {
+  return storage_.pointer_;
 }
 // Explicit conversion operator to bool for checking if the pointer is valid
-template <typename T> uniquePointer<T>::operator bool() const {
-  return pointer_ != nullptr;
+template <typename T, typename D> uniquePointer<T, D>::operator bool() const {
+  return storage_.pointer_ != pointer();
 }
 // Resetting the pointer to a new value or nullptr
-template <typename T> void uniquePointer<T>::reset(T *ptr) {
-  if (pointer_ != ptr) {
-    delete pointer_;
-    pointer_ = ptr;
+template <typename T, typename D> void uniquePointer<T, D>::reset(pointer ptr) {
+  if (storage_.pointer_ != ptr) {
+    pointer old = storage_.pointer_;
+    storage_.pointer_ = ptr;
+    if (old != pointer()) {
+      get_deleter()(old);
+    }
   }
 }
 // Releasing ownership of the pointer and returning it
-template <typename T> T *uniquePointer<T>::release() {
-  T *released = pointer_;
-  pointer_ = nullptr;
+template <typename T, typename D>
+typename uniquePointer<T, D>::pointer uniquePointer<T, D>::release() {
+  pointer released = storage_.pointer_;
+  storage_.pointer_ = pointer();
+  return released;
+}
+// Swapping method that swaps the contents of two uniquePointers
+template <typename T, typename D>
+void uniquePointer<T, D>::swap(uniquePointer &other) {
+  using std::swap;
+  swap(storage_.pointer_, other.storage_.pointer_);
+  swap(get_deleter(), other.get_deleter());
+}
+// Getters for the stored deleter
+template <typename T, typename D>
+D &uniquePointer<T, D>::get_deleter() noexcept {
+  return storage_.value();
+}
+template <typename T, typename D>
+const D &uniquePointer<T, D>::get_deleter() const noexcept {
+  return storage_.value();
+}
+
+// Array specialization, delete[] by default and operator[] instead of * and ->
+template <typename T, typename D> class uniquePointer<T[], D> {
+public:
+  using pointer = typename deleterPointer<T[], D>::type;
+  using element_type = T;
+  using deleter_type = D;
+
+private:
+  // Raw pointers other than T* (or a less qualified T*), e.g. a Derived*
+  // that delete[] would then walk with the size of T
+  template <typename U>
+  using rejected = std::enable_if_t<
+      std::is_same<pointer, T *>::value &&
+      !std::is_convertible<U (*)[], T (*)[]>::value>;
+
+public:
+  explicit uniquePointer(pointer ptr = pointer()) noexcept;
+  // Constructors taking the pointer together with the deleter to call on it
+  uniquePointer(pointer ptr, const D &deleter);
+  uniquePointer(pointer ptr, D &&deleter) noexcept;
+  // Arrays of another element type are not accepted, like std::unique_ptr<T[]>
+  template <typename U, typename = rejected<U>>
+  explicit uniquePointer(U *ptr) = delete;
+  template <typename U, typename = rejected<U>>
+  uniquePointer(U *ptr, const D &deleter) = delete;
+  template <typename U, typename = rejected<U>>
+  uniquePointer(U *ptr, D &&deleter) = delete;
+  // Copy constructor deleted to enforce unique ownership
+  uniquePointer(const uniquePointer &other) = delete;
+  // Copy assignment operator deleted to enforce unique ownership
+  uniquePointer &operator=(const uniquePointer &other) = delete;
+  uniquePointer(uniquePointer &&other) noexcept;
+  uniquePointer &operator=(uniquePointer &&other) noexcept;
+  ~uniquePointer();
+  pointer get() const;
+  // Element access
+  T &operator[](std::size_t index) const;
+  explicit operator bool() const;
+  void reset(pointer ptr = pointer());
+  template <typename U, typename = rejected<U>> void reset(U *ptr) = delete;
+  pointer release();
+  void swap(uniquePointer &other);
+  // Access to the stored deleter
+  D &get_deleter() noexcept;
+  const D &get_deleter() const noexcept;
+
+private:
+  // Same layout as the single object version
+  struct storage : eboStorage<D> {
+    explicit storage(pointer ptr) : eboStorage<D>(), pointer_(ptr) {}
+    template <typename E>
+    storage(pointer ptr, E &&deleter)
+        : eboStorage<D>(std::forward<E>(deleter)), pointer_(ptr) {}
+    pointer pointer_;
+  };
+  storage storage_;
+};
+// Explicit constructor initializing the pointer with a default value of nullptr
+template <typename T, typename D>
+uniquePointer<T[], D>::uniquePointer(pointer ptr) noexcept : storage_(ptr) {}
+// Constructors initializing the pointer together with its deleter
+template <typename T, typename D>
+uniquePointer<T[], D>::uniquePointer(pointer ptr, const D &deleter)
+    : storage_(ptr, deleter) {}
+template <typename T, typename D>
+uniquePointer<T[], D>::uniquePointer(pointer ptr, D &&deleter) noexcept
+    : storage_(ptr, std::move(deleter)) {}
+// Move constructor
+template <typename T, typename D>
+uniquePointer<T[], D>::uniquePointer(uniquePointer &&other) noexcept
+    : storage_(other.release(), std::move(other.get_deleter())) {}
+// Move assignment operator
+template <typename T, typename D>
+uniquePointer<T[], D> &
+uniquePointer<T[], D>::operator=(uniquePointer &&other) noexcept {
+  if (this != &other) {
+    reset(other.release());
+    get_deleter() = std::move(other.get_deleter());
+  }
+  return *this;
+}
+// Destructor releasing the whole array
+template <typename T, typename D> uniquePointer<T[], D>::~uniquePointer() {
+  if (storage_.pointer_ != pointer()) {
+    get_deleter()(storage_.pointer_);
+  }
+}
+// Getter function to retrieve the raw pointer
+template <typename T, typename D>
+typename uniquePointer<T[], D>::pointer uniquePointer<T[], D>::get() const {
+  return storage_.pointer_;
+}
+// Subscript operator for accessing the elements
+template <typename T, typename D>
+T &uniquePointer<T[], D>::operator[](std::size_t index) const {
+  return storage_.pointer_[index];
+}
+// Explicit conversion operator to bool for checking if the pointer is valid
+template <typename T, typename D>
+uniquePointer<T[], D>::operator bool() const {
+  return storage_.pointer_ != pointer();
+}
+// Resetting the pointer to a new array or nullptr
+template <typename T, typename D>
+void uniquePointer<T[], D>::reset(pointer ptr) {
+  if (storage_.pointer_ != ptr) {
+    pointer old = storage_.pointer_;
+    storage_.pointer_ = ptr;
+    if (old != pointer()) {
+      get_deleter()(old);
+    }
+  }
+}
+// Releasing ownership of the array and returning it
+template <typename T, typename D>
+typename uniquePointer<T[], D>::pointer uniquePointer<T[], D>::release() {
+  pointer released = storage_.pointer_;
+  storage_.pointer_ = pointer();
   return released;
 }
 // Swapping method that swaps the contents of two uniquePointers
-template <typename T> void uniquePointer<T>::swap(uniquePointer &other) {
-  std::swap(pointer_, other.pointer_);
+template <typename T, typename D>
+void uniquePointer<T[], D>::swap(uniquePointer &other) {
+  using std::swap;
+  swap(storage_.pointer_, other.storage_.pointer_);
+  swap(get_deleter(), other.get_deleter());
+}
+// Getters for the stored deleter
+template <typename T, typename D>
+D &uniquePointer<T[], D>::get_deleter() noexcept {
+  return storage_.value();
+}
+template <typename T, typename D>
+const D &uniquePointer<T[], D>::get_deleter() const noexcept {
+  return storage_.value();
 }
 // Free function swap that calls upon the swap method...
-template <typename T>
-void swap(uniquePointer<T> &one, uniquePointer<T> &other) {
+template <typename T, typename D>
+void swap(uniquePointer<T, D> &one, uniquePointer<T, D> &other) {
   one.swap(other);
 }
 
-} // namespace eds
\ No newline at end of file
+} // namespace eds
@@ -1,188 +1,223 @@
 #pragma once
 #include "shared.hpp"
+#include <type_traits>
 #include <utility>
 
 namespace eds {
-template <typename T> class sharedPointer;
-template <typename T> class weakPointer {
+// Policy has to match the one of the observed sharedPointer
+template <typename T, typename Policy> class weakPointer {
 public:
+  // T itself, or the element type for weakPointer<T[]>
+  using element_type = std::remove_extent_t<T>;
+
   // Default constructor
   weakPointer() noexcept;
   // Constructor from sharedPointer of a different type
-  template <typename U> weakPointer(const sharedPointer<U> &other) noexcept;
+  template <typename U>
+  weakPointer(const sharedPointer<U, Policy> &other) noexcept;
   // Copy constructor from weakPointer of a different type
-  template <typename U> weakPointer(const weakPointer<U> &other) noexcept;
+  template <typename U>
+  weakPointer(const weakPointer<U, Policy> &other) noexcept;
   // Copy constructor from weakPointer
   weakPointer(const weakPointer &other) noexcept;
   // Copy assignment operator
   weakPointer &operator=(const weakPointer &other) noexcept;
   // Copy assignment operator from nullptr
   weakPointer &operator=(std::nullptr_t) noexcept;
-  //Move constructor 
-  weakPointer(weakPointer&& other) noexcept;   
+  //Move constructor
+  weakPointer(weakPointer&& other) noexcept;
   //Move assigment operator
-  weakPointer &operator=(weakPointer&& other) noexcept; 
+  weakPointer &operator=(weakPointer&& other) noexcept;
   // Destructor
   ~weakPointer();
   // Reset function
   void reset() noexcept;
-  // Use count function
+  // Use count function, number of weak references while the object is alive
   std::size_t use_count() const noexcept;
   // Expired function
   bool expired() const noexcept;
   // Lock function to convert to sharedPointer
-  sharedPointer<T> lock() const noexcept;
+  sharedPointer<T, Policy> lock() const noexcept;
   //Swap method
   void swap(weakPointer &other);
 
 private:
-  std::size_t *weakCounter_;
-  std::size_t *sharedCounter_;
-  T *pointer_;
+  // Raw pointer to the observed resource
+  element_type *pointer_;
+  // Control block shared with the sharedPointers of the resource
+  controlBlock<Policy> *control_;
   // Helper function to increment the weak counter
   void increment_weak();
   // Helper function to decrement the weak counter
   void decrement_weak();
-  template <typename U> friend class sharedPointer;
+  template <typename U, typename P> friend class weakPointer;
+  template <typename U, typename P> friend class sharedPointer;
+  template <typename Handle> friend class atomicSlot;
 };
 
 // Default constructor
-template <typename T>
-weakPointer<T>::weakPointer() noexcept
-    : weakCounter_(nullptr), sharedCounter_(nullptr), pointer_(nullptr) {}
+template <typename T, typename Policy>
+weakPointer<T, Policy>::weakPointer() noexcept
+    : pointer_(nullptr), control_(nullptr) {}
 
 // Constructor from sharedPointer of a different type
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-weakPointer<T>::weakPointer(const sharedPointer<U> &other) noexcept
-    : weakCounter_(other.weakCounter_), sharedCounter_(other.counter_),pointer_(other.pointer_) {
+weakPointer<T, Policy>::weakPointer(
+    const sharedPointer<U, Policy> &other) noexcept
+    : pointer_(other.pointer_), control_(other.control_) {
   increment_weak();
 }
 
 // Copy constructor from weakPointer of a different type
-template <typename T>
+template <typename T, typename Policy>
 template <typename U>
-weakPointer<T>::weakPointer(const weakPointer<U> &other) noexcept
-    : weakCounter_(other.weakCounter_), sharedCounter_(other.sharedCounter_),pointer_(other.pointer_) {
+weakPointer<T, Policy>::weakPointer(
+    const weakPointer<U, Policy> &other) noexcept
+    : pointer_(other.pointer_), control_(other.control_) {
   increment_weak();
 }
 // Copy constructor from weakPointe
-template <typename T>
-weakPointer<T>::weakPointer(const weakPointer &other) noexcept
-    : weakCounter_(other.weakCounter_), sharedCounter_(other.sharedCounter_),pointer_(other.pointer_) {
+template <typename T, typename Policy>
+weakPointer<T, Policy>::weakPointer(const weakPointer &other) noexcept
+    : pointer_(other.pointer_), control_(other.control_) {
   increment_weak();
 }
 
 
 // Copy assignment operator
-template <typename T>
-weakPointer<T> &weakPointer<T>::operator=(const weakPointer &other) noexcept {
+template <typename T, typename Policy>
+weakPointer<T, Policy> &weakPointer<T, Policy>::operator=(const weakPointer &other) noexcept {
   if (this != &other) {
-    reset();
-    weakCounter_ = other.weakCounter_;
-    sharedCounter_ = other.sharedCounter_;
-    pointer_ = other.pointer_;
-    increment_weak();
+    weakPointer(other).swap(*this);
   }
   return *this;
 }
 
 // Copy assignment operator from nullptr
-template <typename T>
-weakPointer<T> &weakPointer<T>::operator=(std::nullptr_t) noexcept {
+template <typename T, typename Policy>
+weakPointer<T, Policy> &weakPointer<T, Policy>::operator=(std::nullptr_t) noexcept {
   reset();
   return *this;
 }
 // Move constructor
-template <typename T>
-weakPointer<T>::weakPointer(weakPointer&& other) noexcept
-  :weakCounter_{other.weakCounter_},sharedCounter_{other.sharedCounter_},pointer_{other.pointer_}{
+template <typename T, typename Policy>
+weakPointer<T, Policy>::weakPointer(weakPointer&& other) noexcept
+  :pointer_{other.pointer_},control_{other.control_}{
         other.pointer_=nullptr;
-        other.sharedCounter_=nullptr;
-        other.weakCounter_=nullptr;
+        other.control_=nullptr;
 }
 
 // Move assignment operator
-template <typename T>
-weakPointer<T>& weakPointer<T>::operator=(weakPointer&& other) noexcept {
- if(pointer_==other.pointer_)
-            {return *this;} 
-        delete pointer_;
-        delete sharedCounter_;
-        delete weakCounter_;
-
-        pointer_=other.pointer_;
-        sharedCounter_=other.sharedCounter_;
-        weakCounter_=other.weakCounter_;
-
-        other.pointer_=nullptr;
-        other.sharedCounter_=nullptr;
-        other.weakCounter_=nullptr;
-
-        return *this;
+template <typename T, typename Policy>
+weakPointer<T, Policy>& weakPointer<T, Policy>::operator=(weakPointer&& other) noexcept {
+  if (this != &other) {
+    weakPointer(std::move(other)).swap(*this);
+  }
+  return *this;
 }
 
 // Destructor
-template <typename T> weakPointer<T>::~weakPointer() {
-  if (weakCounter_ != nullptr) {
-    if (--(*weakCounter_) == 0) {
-      delete weakCounter_;
-      weakCounter_ = nullptr;
-    }
-  }
-}
+template <typename T, typename Policy>
+weakPointer<T, Policy>::~weakPointer() { decrement_weak(); }
 
 // Reset function
-template <typename T> void weakPointer<T>::reset() noexcept {
+template <typename T, typename Policy>
+void weakPointer<T, Policy>::reset() noexcept {
   decrement_weak();
-  if (use_count() == 0) {
-    weakCounter_ = nullptr;
-  }
+  pointer_ = nullptr;
 }
 
 // Use count function
-template <typename T> std::size_t weakPointer<T>::use_count() const noexcept {
-  return (weakCounter_ != nullptr) ? *weakCounter_ : 0;
+template <typename T, typename Policy>
+std::size_t weakPointer<T, Policy>::use_count() const noexcept {
+  return (control_ != nullptr && control_->shared_count() != 0)
+             ? control_->weak_count()
+             : 0;
 }
 
 // Expired function
-template <typename T> bool weakPointer<T>::expired() const noexcept {
-  return use_count() == 0;
-}
-
-template <typename T> sharedPointer<T> weakPointer<T>::lock() const noexcept {
-  if (!expired()) {
-    // If the weak pointer is not expired, create and return a shared pointer
-    // std::cout << "Test1" << std::endl;
-    return sharedPointer<T>(*this);
-  } else {
-    // If the weak pointer is expired, return an empty shared pointer
-    return sharedPointer<T>();
-  }
+template <typename T, typename Policy>
+bool weakPointer<T, Policy>::expired() const noexcept {
+  return control_ == nullptr || control_->shared_count() == 0;
+}
+
+template <typename T, typename Policy>
+sharedPointer<T, Policy> weakPointer<T, Policy>::lock() const noexcept {
+  // The sharedPointer constructor only takes a reference if the object is alive,
+  // otherwise it stays empty
+  return sharedPointer<T, Policy>(*this);
 }
 // method swap
-template <typename T> void weakPointer<T>::swap(weakPointer &other) {
+template <typename T, typename Policy>
+void weakPointer<T, Policy>::swap(weakPointer &other) {
   std::swap(pointer_, other.pointer_);
+  std::swap(control_, other.control_);
 }
 // free function swap
-template <typename T> void swap(weakPointer<T> &one, weakPointer<T> &other) {
+template <typename T, typename Policy>
+void swap(weakPointer<T, Policy> &one, weakPointer<T, Policy> &other) {
   one.swap(other);
 }
 
 // Helper function to increment the weak counter
-template <typename T> void weakPointer<T>::increment_weak() {
-  if (weakCounter_ != nullptr) {
-    ++(*weakCounter_);
+template <typename T, typename Policy>
+void weakPointer<T, Policy>::increment_weak() {
+  if (control_ != nullptr) {
+    control_->add_weak();
   }
 }
 
-template <typename T> void weakPointer<T>::decrement_weak() {
-  if (weakCounter_ != nullptr) {
-    if (--(*weakCounter_) == 0) {
-      delete weakCounter_;
-      weakCounter_ = nullptr; // Set to null after deletion
-    }
+template <typename T, typename Policy>
+void weakPointer<T, Policy>::decrement_weak() {
+  if (control_ != nullptr) {
+    control_->release_weak();
+    control_ = nullptr; // Set to null after releasing
   }
 }
 
+/****************************************************************************
+*Base class for objects that need a sharedPointer to themselves (callbacks, *
+*handing out views of their members). make_shared and sharedPointer(T*)     *
+*recognize it and point a weak self-reference at the new owner, so          *
+*shared_from_this() shares the existing control block instead of creating a *
+*second one. Policy has to match the one of the owning sharedPointer.       *
+****************************************************************************/
+template <typename T, typename Policy> class enableSharedFromThis {
+public:
+  // Owner of this object, empty if no sharedPointer owns it (yet or anymore)
+  sharedPointer<T, Policy> shared_from_this();
+  sharedPointer<const T, Policy> shared_from_this() const;
+  // Weak reference to this object
+  weakPointer<T, Policy> weak_from_this() noexcept { return weakThis_; }
+  weakPointer<const T, Policy> weak_from_this() const noexcept {
+    return weakThis_;
+  }
+
+protected:
+  enableSharedFromThis() noexcept = default;
+  // A copy is a different object with owners of its own
+  enableSharedFromThis(const enableSharedFromThis &) noexcept {}
+  enableSharedFromThis &operator=(const enableSharedFromThis &) noexcept {
+    return *this;
+  }
+  ~enableSharedFromThis() = default;
+
+private:
+  // Set by the first sharedPointer that takes ownership of the object
+  mutable weakPointer<T, Policy> weakThis_;
+  template <typename U, typename P> friend class sharedPointer;
+};
+
+template <typename T, typename Policy>
+sharedPointer<T, Policy> enableSharedFromThis<T, Policy>::shared_from_this() {
+  return weakThis_.lock();
+}
+
+template <typename T, typename Policy>
+sharedPointer<const T, Policy>
+enableSharedFromThis<T, Policy>::shared_from_this() const {
+  return sharedPointer<const T, Policy>(weakThis_);
+}
+
 } // namespace eds